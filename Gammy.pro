@@ -28,9 +28,58 @@ win32 {
 }
 
 unix {
-    HEADERS += src/dspctl-xlib.h
-    SOURCES += src/dspctl-xlib.cpp
-    LIBS += -lX11 -lXxf86vm -lXext
+    HEADERS += src/dspctl-xlib.h src/backlight.h src/als.h
+    SOURCES += src/dspctl-xlib.cpp src/backlight.cpp src/als.cpp
+    LIBS += -lX11 -lXxf86vm -lXext -lXss -lXrandr
+
+    # qmake CONFIG+=gammy_xcb
+    gammy_xcb {
+        message(XCB backend)
+        HEADERS += src/dspctl-xcb.h
+        SOURCES += src/dspctl-xcb.cpp
+        LIBS    += -lxcb -lxcb-shm -lxcb-randr
+        DEFINES += GAMMY_XCB
+    }
+
+    # qmake CONFIG+=gammy_drm
+    gammy_drm {
+        message(DRM backend)
+        HEADERS   += src/dspctl-drm.h
+        SOURCES   += src/dspctl-drm.cpp
+        CONFIG    += link_pkgconfig
+        PKGCONFIG += libdrm
+        DEFINES   += GAMMY_DRM
+    }
+
+    # qmake CONFIG+=gammy_wayland
+    # Needs wayland-scanner and the wlr-protocols XML files.
+    gammy_wayland {
+        message(Wayland backend)
+        HEADERS   += src/dspctl-wayland.h
+        SOURCES   += src/dspctl-wayland.cpp
+        CONFIG    += link_pkgconfig
+        PKGCONFIG += wayland-client
+        DEFINES   += GAMMY_WAYLAND
+
+        WLR_PROTOCOLS = $$system(pkg-config --variable=pkgdatadir wlr-protocols)
+        WL_PROTOCOLS  = $$WLR_PROTOCOLS/unstable/wlr-gamma-control-unstable-v1.xml \
+                        $$WLR_PROTOCOLS/unstable/wlr-screencopy-unstable-v1.xml
+        INCLUDEPATH  += $$OUT_PWD/build/wayland
+
+        wl_header.input          = WL_PROTOCOLS
+        wl_header.output         = $$OUT_PWD/build/wayland/${QMAKE_FILE_BASE}-client-protocol.h
+        wl_header.commands       = wayland-scanner client-header ${QMAKE_FILE_IN} ${QMAKE_FILE_OUT}
+        wl_header.variable_out   = HEADERS
+        wl_header.CONFIG        += target_predeps no_link
+
+        wl_code.input            = WL_PROTOCOLS
+        wl_code.output           = $$OUT_PWD/build/wayland/${QMAKE_FILE_BASE}-protocol.c
+        wl_code.commands         = wayland-scanner private-code ${QMAKE_FILE_IN} ${QMAKE_FILE_OUT}
+        wl_code.depends          = $$OUT_PWD/build/wayland/${QMAKE_FILE_BASE}-client-protocol.h
+        wl_code.variable_out     = SOURCES
+
+        QMAKE_EXTRA_COMPILERS += wl_header wl_code
+    }
 
     isEmpty(PREFIX) {
         PREFIX = /usr
@@ -66,7 +115,19 @@ HEADERS += src/mainwindow.h src/utils.h \
     src/tempscheduler.h \
     src/cfg.h \
     src/RangeSlider.h \
-    src/defs.h
+    src/defs.h \
+    src/luma.h \
+    src/pixfmt.h \
+    src/ramp.h \
+    src/colortemp.h \
+    src/icc.h \
+    src/solar.h \
+    src/timeline.h \
+    src/easing.h \
+    src/transition.h \
+    src/filter.h \
+    src/asyncappender.h \
+    src/sampler.h
 
 SOURCES += src/main.cpp src/mainwindow.cpp src/utils.cpp \
     src/component.cpp \
@@ -74,7 +135,18 @@ SOURCES += src/main.cpp src/mainwindow.cpp src/utils.cpp \
     src/mediator.cpp \
     src/tempscheduler.cpp \
     src/cfg.cpp \
-    src/RangeSlider.cpp
+    src/RangeSlider.cpp \
+    src/luma.cpp \
+    src/pixfmt.cpp \
+    src/ramp.cpp \
+    src/icc.cpp \
+    src/solar.cpp \
+    src/timeline.cpp \
+    src/easing.cpp \
+    src/transition.cpp \
+    src/filter.cpp \
+    src/asyncappender.cpp \
+    src/sampler.cpp
 
 FORMS += src/mainwindow.ui \
     src/tempscheduler.ui \
@@ -0,0 +1,326 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include "als.h"
+#include "cfg.h"
+#include "defs.h"
+
+namespace fs = std::filesystem;
+
+static bool readText(const fs::path &p, std::string &out)
+{
+	std::ifstream f(p);
+	return bool(std::getline(f, out));
+}
+
+static double readNumber(const fs::path &p)
+{
+	std::ifstream f(p);
+	double v;
+	return (f >> v) ? v : NAN;
+}
+
+static bool writeText(const fs::path &p, const std::string &s)
+{
+	std::ofstream f(p);
+	return bool(f << s << std::flush);
+}
+
+AmbientLight::AmbientLight()
+{
+	if (!cfg["als"].get<bool>())
+		return;
+
+	const fs::path root = cfg["als_path"].get<std::string>();
+
+	std::error_code ec;
+
+	for (const auto &e : fs::directory_iterator(root, ec)) {
+		for (const char *p : { "in_illuminance", "in_illuminance0" }) {
+			if (fs::exists(e.path() / (std::string(p) + "_input")) || fs::exists(e.path() / (std::string(p) + "_raw"))) {
+				dir    = e.path().string();
+				prefix = p;
+				break;
+			}
+		}
+		if (!dir.empty())
+			break;
+	}
+
+	if (dir.empty()) {
+		LOGW << "No ambient light sensor found in: " << root.string();
+		return;
+	}
+
+	const double s = readNumber(dir + '/' + prefix + "_scale");
+	const double o = readNumber(dir + '/' + prefix + "_offset");
+	scale  = std::isnan(s) ? 1 : s;
+	offset = std::isnan(o) ? 0 : o;
+
+	dev = cfg["als_dev_path"].get<std::string>() + '/' + fs::path(dir).filename().string();
+
+	int fd = -1;
+
+	if (setupBuffer()) {
+		fd = open(dev.c_str(), O_RDONLY | O_NONBLOCK);
+
+		if (fd == -1) {
+			LOGD << "Unable to open " << dev;
+			disableBuffer();
+		}
+	}
+
+	if (fd != -1 && (quit_fd = eventfd(0, EFD_CLOEXEC)) == -1) {
+		LOGD << "eventfd failed";
+		close(fd);
+		fd = -1;
+		disableBuffer();
+	}
+
+	LOGI << "Ambient light sensor: " << dir << (fd != -1 ? " (buffered)" : " (polled)");
+
+	if (fd != -1)
+		reader = std::thread([this, fd] { runBuffered(fd); });
+	else
+		reader = std::thread([this] { runPolling(); });
+}
+
+AmbientLight::~AmbientLight()
+{
+	{
+		std::lock_guard lock(mtx);
+		quit = true;
+	}
+
+	cv.notify_one();
+
+	if (quit_fd != -1) {
+		const uint64_t one = 1;
+
+		if (write(quit_fd, &one, sizeof(one)) != sizeof(one))
+			LOGE << "Unable to stop the ambient light reader";
+	}
+
+	if (reader.joinable())
+		reader.join();
+
+	if (quit_fd != -1)
+		close(quit_fd);
+}
+
+bool AmbientLight::available() const
+{
+	return cur_lux >= 0;
+}
+
+double AmbientLight::lux() const
+{
+	return cur_lux;
+}
+
+/**
+ * Perceived ambient brightness in [0, 1]: lux on a log scale,
+ * saturating at "als_lux_max".
+ */
+double AmbientLight::level() const
+{
+	const double max = std::max(cfg["als_lux_max"].get<double>(), 1.);
+	return std::clamp(std::log10(1 + std::max(lux(), 0.)) / std::log10(1 + max), 0., 1.);
+}
+
+/**
+ * Enables the illuminance channel and the buffer, and works out where the
+ * channel is in each sample: enabled channels are laid out by scan index,
+ * each aligned to its own storage size.
+ */
+bool AmbientLight::setupBuffer()
+{
+	const fs::path scan = fs::path(dir) / "scan_elements";
+	std::string    trigger;
+
+	if (!fs::exists(scan / (prefix + "_en")) || !readText(fs::path(dir) / "trigger" / "current_trigger", trigger) || trigger.empty())
+		return false;
+
+	// The buffer may be in use by someone else, e.g. iio-sensor-proxy
+	std::string enabled;
+	if (readText(fs::path(dir) / "buffer" / "enable", enabled) && enabled == "1")
+		return false;
+
+	std::string en;
+	was_enabled = readText(scan / (prefix + "_en"), en) && en == "1";
+
+	if (!writeText(scan / (prefix + "_en"), "1"))
+		return false;
+
+	struct Chan { int index, bytes; bool self; };
+	std::vector<Chan> chans;
+
+	std::error_code ec;
+
+	for (const auto &e : fs::directory_iterator(scan, ec)) {
+		const std::string f = e.path().filename().string();
+
+		if (f.size() < 3 || f.compare(f.size() - 3, 3, "_en") != 0)
+			continue;
+
+		std::string on;
+		if (!readText(e.path(), on) || on != "1")
+			continue;
+
+		const std::string base = f.substr(0, f.size() - 3);
+		const double      idx  = readNumber(scan / (base + "_index"));
+
+		std::string type;
+		if (std::isnan(idx) || !readText(scan / (base + "_type"), type)) {
+			disableBuffer();
+			return false;
+		}
+
+		// e.g. "le:u32/32>>0"
+		char endian[3] {}, sign;
+		int  bits, storage, shift;
+
+		if (std::sscanf(type.c_str(), "%2s:%c%d/%d>>%d", endian, &sign, &bits, &storage, &shift) != 5 || storage % 8) {
+			disableBuffer();
+			return false;
+		}
+
+		const bool self = base == prefix;
+
+		if (self) {
+			chan_bits   = bits;
+			chan_shift  = shift;
+			chan_bytes  = storage / 8;
+			chan_signed = sign == 's';
+			chan_be     = std::string(endian) == "be";
+		}
+
+		chans.push_back({ int(idx), storage / 8, self });
+	}
+
+	std::sort(chans.begin(), chans.end(), [] (const Chan &a, const Chan &b) { return a.index < b.index; });
+
+	int off = 0, align = 1;
+
+	for (const auto &c : chans) {
+		off = (off + c.bytes - 1) / c.bytes * c.bytes;
+		if (c.self)
+			chan_offset = off;
+		off  += c.bytes;
+		align = std::max(align, c.bytes);
+	}
+
+	sample_sz = (off + align - 1) / align * align;
+
+	if (chan_bytes == 0 || chan_bytes > 8 || !writeText(fs::path(dir) / "buffer" / "enable", "1")) {
+		disableBuffer();
+		return false;
+	}
+
+	return true;
+}
+
+void AmbientLight::disableBuffer()
+{
+	writeText(fs::path(dir) / "buffer" / "enable", "0");
+
+	if (!was_enabled)
+		writeText(fs::path(dir) / "scan_elements" / (prefix + "_en"), "0");
+}
+
+double AmbientLight::readSysfs() const
+{
+	const double input = readNumber(dir + '/' + prefix + "_input");
+
+	if (!std::isnan(input))
+		return input;
+
+	const double raw = readNumber(dir + '/' + prefix + "_raw");
+
+	return std::isnan(raw) ? -1 : (raw + offset) * scale;
+}
+
+void AmbientLight::runBuffered(int fd)
+{
+	std::vector<uint8_t> buf(sample_sz * 16);
+
+	// The first sample may take a while: start from the sysfs value
+	const double initial = readSysfs();
+	if (initial >= 0)
+		cur_lux = initial;
+
+	pollfd fds[] {
+		{ fd,      POLLIN, 0 },
+		{ quit_fd, POLLIN, 0 },
+	};
+
+	while (true) {
+		if (poll(fds, 2, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+
+			LOGE << "Ambient light poll failed: " << strerror(errno);
+			break;
+		}
+
+		if (fds[1].revents)
+			break;
+
+		if (!(fds[0].revents & POLLIN)) {
+			LOGE << "Ambient light device lost";
+			break;
+		}
+
+		const ssize_t n = read(fd, buf.data(), buf.size());
+
+		if (n < sample_sz)
+			continue;
+
+		// Only the latest sample matters
+		const uint8_t *s = &buf[(n / sample_sz - 1) * sample_sz + chan_offset];
+		uint64_t v = 0;
+
+		for (int i = 0; i < chan_bytes; ++i)
+			v |= uint64_t(s[chan_be ? i : chan_bytes - 1 - i]) << (8 * (chan_bytes - 1 - i));
+
+		v >>= chan_shift;
+		v &= chan_bits < 64 ? (uint64_t(1) << chan_bits) - 1 : ~uint64_t(0);
+
+		int64_t raw = int64_t(v);
+		if (chan_signed && chan_bits < 64 && (v >> (chan_bits - 1)) & 1)
+			raw -= int64_t(1) << chan_bits;
+
+		cur_lux = std::max((raw + offset) * scale, 0.);
+	}
+
+	close(fd);
+	disableBuffer();
+}
+
+void AmbientLight::runPolling()
+{
+	using namespace std::chrono;
+
+	std::unique_lock lock(mtx);
+
+	while (!quit) {
+		const double l = readSysfs();
+		if (l >= 0)
+			cur_lux = l;
+
+		cv.wait_for(lock, milliseconds(std::max(cfg["als_interval"].get<int>(), 100)), [&] { return quit; });
+	}
+}
@@ -0,0 +1,64 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef ALS_H
+#define ALS_H
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "defs.h"
+
+/**
+ * Ambient light sensor, from an IIO device under "als_path"
+ * (/sys/bus/iio/devices by default).
+ * When the device has a trigger, samples are read from its character device
+ * (under "als_dev_path") as they arrive. Otherwise the sysfs value is read
+ * every "als_interval" ms. Either way, it happens on a separate thread
+ * and the latest value is kept.
+ */
+class AmbientLight
+{
+public:
+	AmbientLight();
+	~AmbientLight();
+	bool   available() const;
+	double lux() const;
+	double level() const;
+private:
+	std::string dir;
+	std::string dev;
+	std::string prefix; // "in_illuminance" or "in_illuminance0"
+	double scale  = 1;
+	double offset = 0;
+
+	// Layout of the illuminance channel in a buffered sample
+	int  sample_sz    = 0;
+	int  chan_offset  = 0;
+	int  chan_bytes   = 0;
+	int  chan_bits    = 0;
+	int  chan_shift   = 0;
+	bool chan_signed  = false;
+	bool chan_be      = false;
+	bool was_enabled  = false;
+
+	std::atomic<double> cur_lux = -1;
+	std::thread         reader;
+
+	// The reader sleeps until the next sample or until it's told to quit
+	std::mutex mtx;
+	convar     cv;
+	bool       quit    = false;
+	int        quit_fd = -1; // eventfd, wakes up the buffered reader
+
+	bool   setupBuffer();
+	void   disableBuffer();
+	double readSysfs() const;
+	void   runBuffered(int fd);
+	void   runPolling();
+};
+
+#endif // ALS_H
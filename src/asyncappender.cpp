@@ -0,0 +1,213 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "asyncappender.h"
+
+/**
+ * A record rebuilt from a ring entry, so the downstream appenders
+ * format it as if it came straight from the logging thread.
+ */
+class AsyncAppender::Replay : public plog::Record
+{
+public:
+	Replay(const Entry &e) : plog::Record(e.severity, "", e.line, e.file, nullptr, PLOG_DEFAULT_INSTANCE_ID), e(e) {}
+
+	const plog::util::Time& getTime() const override { return e.time; }
+	unsigned int getTid() const override { return e.tid; }
+	const plog::util::nchar* getMessage() const override { return e.msg; }
+	const char* getFunc() const override { return e.func; }
+private:
+	const Entry &e;
+};
+
+template <class Char>
+static void copyTruncated(Char *dst, const Char *src, size_t max)
+{
+	const size_t len = std::min(std::char_traits<Char>::length(src), max - 1);
+	std::char_traits<Char>::copy(dst, src, len);
+	dst[len] = 0;
+}
+
+static size_t roundUpPow2(size_t n)
+{
+	size_t p = 2;
+	while (p < n)
+		p <<= 1;
+	return p;
+}
+
+AsyncAppender::AsyncAppender(std::vector<plog::IAppender*> appenders, size_t slots, int flush_ms)
+    : appenders(std::move(appenders)),
+      ring(new Slot[roundUpPow2(slots)]),
+      mask(roundUpPow2(slots) - 1),
+      flush_ms(flush_ms)
+{
+	for (size_t i = 0; i <= mask; ++i)
+		ring[i].seq.store(i, std::memory_order_relaxed);
+
+	flusher = std::thread([this] { run(); });
+}
+
+/**
+ * Runs on exit() as well (the appender is static), so the records
+ * logged right before a LOGF are still written.
+ */
+AsyncAppender::~AsyncAppender()
+{
+	{
+		// Under the mutex, or the flusher may miss it right before an untimed wait
+		std::lock_guard lock(mtx);
+		quit = true;
+	}
+
+	cv.notify_one();
+	flusher.join();
+}
+
+void AsyncAppender::write(const plog::Record &record)
+{
+	size_t pos = head.load(std::memory_order_relaxed);
+	Slot   *s;
+
+	for (;;) {
+		s = &ring[pos & mask];
+
+		const size_t   seq  = s->seq.load(std::memory_order_acquire);
+		const intptr_t diff = intptr_t(seq) - intptr_t(pos);
+
+		if (diff == 0) {
+			if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			// Full: the flusher is behind by a whole ring
+			drop_count.fetch_add(1, std::memory_order_relaxed);
+			return;
+		} else {
+			pos = head.load(std::memory_order_relaxed);
+		}
+	}
+
+	Entry &e   = s->e;
+	e.time     = record.getTime();
+	e.severity = record.getSeverity();
+	e.tid      = record.getTid();
+	e.line     = record.getLine();
+	e.file     = record.getFile();
+	copyTruncated(e.func, record.getFunc(), func_max);
+	copyTruncated(e.msg, record.getMessage(), msg_max);
+
+	s->seq.store(pos + 1, std::memory_order_release);
+
+	// Pairs with the fence in run(): either we see the flusher idle,
+	// or it sees this record before going to sleep
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// The first record into an empty ring must not be missed: there's no timeout
+	if (idle.load(std::memory_order_relaxed) && idle.exchange(false)) {
+		// Waits out the flusher's predicate check, so the notification can't slip in before its wait
+		{ std::lock_guard lock(mtx); }
+		cv.notify_one();
+	}
+
+	// Errors are written right away, bursts every half ring.
+	// Notifying without the mutex may miss the flusher's wait,
+	// in which case the records are written on the next tick.
+	if (e.severity <= plog::error || (pos & (mask >> 1)) == 0)
+		cv.notify_one();
+}
+
+uint64_t AsyncAppender::dropped() const
+{
+	return drop_count.load(std::memory_order_relaxed);
+}
+
+/**
+ * Whether the next record is published. Only the flusher may call it.
+ */
+bool AsyncAppender::pending() const
+{
+	return ring[tail & mask].seq.load(std::memory_order_acquire) == tail + 1;
+}
+
+/**
+ * Writes everything published so far. Returns false if the ring was empty.
+ */
+bool AsyncAppender::drain()
+{
+	bool wrote = false;
+
+	for (;;) {
+		Slot &s = ring[tail & mask];
+
+		if (s.seq.load(std::memory_order_acquire) != tail + 1)
+			break;
+
+		const Replay r(s.e);
+
+		for (auto a : appenders)
+			a->write(r);
+
+		s.seq.store(tail + mask + 1, std::memory_order_release);
+		++tail;
+		wrote = true;
+	}
+
+	const uint64_t drops = dropped();
+
+	if (drops != drop_reported) {
+		Entry e {};
+		plog::util::ftime(&e.time);
+		e.severity = plog::warning;
+		e.tid      = plog::util::gettid();
+		e.line     = __LINE__;
+		e.file     = __FILE__;
+		copyTruncated(e.func, "AsyncAppender::drain", func_max);
+
+		plog::util::nostringstream ss;
+		ss << PLOG_NSTR("Log ring full, dropped records: ") << drops - drop_reported;
+		copyTruncated(e.msg, ss.str().c_str(), msg_max);
+
+		const Replay r(e);
+
+		for (auto a : appenders)
+			a->write(r);
+
+		drop_reported = drops;
+	}
+
+	return wrote;
+}
+
+/**
+ * Sleeps until a record arrives, then gives the burst flush_ms to build up
+ * (less for errors and half full rings) before writing it.
+ */
+void AsyncAppender::run()
+{
+	while (!quit) {
+		{
+			std::unique_lock lock(mtx);
+
+			idle.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			if (!pending())
+				cv.wait(lock, [&] { return !idle || quit; });
+
+			idle = false;
+
+			if (quit)
+				break;
+
+			cv.wait_for(lock, std::chrono::milliseconds(flush_ms));
+		}
+
+		drain();
+	}
+
+	drain();
+}
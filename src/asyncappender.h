@@ -0,0 +1,76 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef ASYNCAPPENDER_H
+#define ASYNCAPPENDER_H
+
+#include <plog/Appenders/IAppender.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "defs.h"
+
+/**
+ * plog appender that copies records into a preallocated ring and hands
+ * them to the real appenders from a background thread.
+ * Logging threads never take a lock or touch a file: a record is one
+ * CAS on the ring's head plus a copy. When the ring is full the record
+ * is dropped and counted, and the count is logged on the next flush.
+ * While the ring is empty the flusher sleeps without a timeout. The first
+ * record after that wakes it, and it writes the batch flush_ms later.
+ * Messages longer than msg_max are truncated.
+ */
+class AsyncAppender : public plog::IAppender
+{
+public:
+	static constexpr size_t msg_max  = 256;
+	static constexpr size_t func_max = 64;
+
+	AsyncAppender(std::vector<plog::IAppender*> appenders, size_t slots = 1024, int flush_ms = 50);
+	~AsyncAppender();
+	void     write(const plog::Record &record) override;
+	uint64_t dropped() const;
+private:
+	struct Entry {
+		plog::util::Time  time;
+		plog::Severity    severity;
+		unsigned int      tid;
+		size_t            line;
+		const char        *file;
+		char              func[func_max];
+		plog::util::nchar msg[msg_max];
+	};
+
+	// Bounded MPSC queue: seq tells producers and the consumer whose turn it is
+	struct Slot {
+		std::atomic<size_t> seq;
+		Entry               e;
+	};
+
+	class Replay;
+
+	std::vector<plog::IAppender*> appenders;
+	std::unique_ptr<Slot[]>       ring;
+	const size_t                  mask;
+	const int                     flush_ms;
+
+	alignas(64) std::atomic<size_t>   head {0};
+	alignas(64) size_t                tail = 0;
+	std::atomic<uint64_t>             drop_count {0};
+	uint64_t                          drop_reported = 0;
+
+	std::atomic_bool quit {false};
+	std::atomic_bool idle {false}; // The flusher is waiting for the first record
+	std::mutex       mtx;
+	convar           cv;
+	std::thread      flusher;
+
+	bool pending() const;
+	bool drain();
+	void run();
+};
+
+#endif // ASYNCAPPENDER_H
@@ -0,0 +1,220 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include "backlight.h"
+#include "cfg.h"
+
+namespace fs = std::filesystem;
+
+Backlight::Backlight()
+{
+	if (!cfg["backlight"].get<bool>())
+		return;
+
+	const fs::path    root   = cfg["backlight_path"].get<std::string>();
+	const std::string device = cfg["backlight_device"];
+
+	std::error_code ec;
+
+	for (const auto &e : fs::directory_iterator(root, ec)) {
+		if (device.empty() || e.path().filename() == device) {
+			dir  = e.path().string();
+			name = e.path().filename().string();
+			break;
+		}
+	}
+
+	if (dir.empty()) {
+		LOGW << "No backlight found in: " << root.string();
+		return;
+	}
+
+	max_level = read("max_brightness");
+	initial   = written = read("brightness");
+
+	if (max_level <= 0 || initial < 0) {
+		LOGE << "Invalid backlight: " << dir;
+		max_level = 0;
+		return;
+	}
+
+	LOGI << "Backlight: " << name << " (" << initial << '/' << max_level << ')';
+
+	writer = std::thread([this] { run(); });
+}
+
+Backlight::~Backlight()
+{
+	{
+		std::lock_guard lock(mtx);
+		quit = true;
+	}
+
+	cv.notify_one();
+
+	if (writer.joinable())
+		writer.join();
+}
+
+bool Backlight::available() const
+{
+	return max_level > 0;
+}
+
+/**
+ * Called on the writer thread, after each level that was written successfully.
+ */
+void Backlight::onWritten(std::function<void()> fn)
+{
+	std::lock_guard lock(mtx);
+	written_fn = std::move(fn);
+}
+
+/**
+ * Queues the coarse level ("backlight_steps") just above the brightness,
+ * but not under "backlight_min".
+ * Returns what's left for the gamma ramp: brightness / backlight, against
+ * the level that is actually on the panel. Until the queued one lands,
+ * that's the previous one.
+ */
+double Backlight::apply(double brightness)
+{
+	if (!available())
+		return brightness;
+
+	const int    steps = std::max(cfg["backlight_steps"].get<int>(), 1);
+	const double min   = std::clamp(cfg["backlight_min"].get<double>(), 0., 1.);
+
+	const double coarse = std::clamp(std::ceil(brightness * steps - 1e-9) / steps, min, 1.);
+	const int    level  = std::max(1, int(std::lround(coarse * max_level)));
+
+	int current;
+	{
+		std::lock_guard lock(mtx);
+		pending = level;
+		current = written;
+	}
+
+	cv.notify_one();
+
+	const double residual = brightness * max_level / std::max(current, 1);
+
+	/* Brightening, the ramp can't make up for a panel that is still dimmer.
+	 * Above the full backlight (brt_extend), gamma still does its part. */
+	if (level > current)
+		return std::min(residual, std::max(brightness, 1.));
+
+	return residual;
+}
+
+/**
+ * Stops the writer, then puts back the level found on startup.
+ */
+void Backlight::restore()
+{
+	if (!available())
+		return;
+
+	{
+		std::lock_guard lock(mtx);
+		quit = true;
+	}
+
+	cv.notify_one();
+
+	if (writer.joinable())
+		writer.join();
+
+	if (written != initial)
+		write(initial);
+}
+
+void Backlight::run()
+{
+	while (true) {
+		int level;
+		{
+			std::unique_lock lock(mtx);
+
+			cv.wait(lock, [&] { return quit || (pending != -1 && pending != written); });
+
+			if (quit)
+				break;
+
+			level = pending;
+		}
+
+		const bool ok = write(level);
+
+		std::function<void()> fn;
+		{
+			std::lock_guard lock(mtx);
+			if (ok) {
+				written = level;
+				fn = written_fn;
+			} else {
+				pending = -1;
+			}
+		}
+
+		// The residual was computed against the previous level
+		if (fn)
+			fn();
+
+		// Anything set meanwhile is coalesced into one write
+		std::this_thread::sleep_for(std::chrono::milliseconds(std::max(cfg["backlight_interval"].get<int>(), 0)));
+	}
+}
+
+int Backlight::read(const std::string &file) const
+{
+	std::ifstream f(dir + '/' + file);
+	int v = -1;
+	f >> v;
+	return f ? v : -1;
+}
+
+bool Backlight::write(int level)
+{
+	if (!use_logind) {
+		std::ofstream f(dir + "/brightness");
+
+		if (f << level << std::flush) {
+			LOGV << "Backlight: " << level;
+			return true;
+		}
+
+		LOGI << "Backlight not writable, using logind";
+		use_logind = true;
+	}
+
+	return writeLogind(level);
+}
+
+bool Backlight::writeLogind(int level)
+{
+	QDBusMessage msg = QDBusMessage::createMethodCall("org.freedesktop.login1",
+	                                                  "/org/freedesktop/login1/session/auto",
+	                                                  "org.freedesktop.login1.Session",
+	                                                  "SetBrightness");
+
+	msg << QString("backlight") << QString::fromStdString(name) << uint(level);
+
+	const QDBusMessage reply = QDBusConnection::systemBus().call(msg);
+
+	if (reply.type() == QDBusMessage::ErrorMessage) {
+		LOGE << "SetBrightness failed: " << reply.errorMessage().toStdString();
+		return false;
+	}
+
+	LOGV << "Backlight (logind): " << level;
+	return true;
+}
@@ -0,0 +1,56 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef BACKLIGHT_H
+#define BACKLIGHT_H
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include "defs.h"
+
+/**
+ * Panel backlight through sysfs ("backlight_path", /sys/class/backlight by default).
+ * It takes the coarse part of the brightness, the gamma ramp the rest,
+ * so the panel actually draws less power when dimmed.
+ * Writes are coalesced on a separate thread: during an animation only
+ * the latest level is written, at most once per "backlight_interval" ms.
+ * The gamma residual is always relative to the level on the panel, so the
+ * owner is called back to re-apply it whenever a new level lands.
+ * If the brightness file is not writable, logind's SetBrightness is used.
+ */
+class Backlight
+{
+public:
+	Backlight();
+	~Backlight();
+	bool   available() const;
+	double apply(double brightness);
+	void   restore();
+	void   onWritten(std::function<void()> fn);
+private:
+	std::string dir;
+	std::string name;
+	int  max_level  = 0;
+	int  initial    = -1;
+	int  written    = -1;
+	int  pending    = -1;
+	bool use_logind = false;
+	bool quit       = false;
+
+	std::mutex  mtx;
+	convar      cv;
+	std::thread writer;
+
+	std::function<void()> written_fn;
+
+	int  read(const std::string &file) const;
+	bool write(int level);
+	bool writeLogind(int level);
+	void run();
+};
+
+#endif // BACKLIGHT_H
@@ -6,6 +6,9 @@
 #include "cfg.h"
 #include "utils.h"
 #include "defs.h"
+#include "luma.h"
+#include "filter.h"
+#include "solar.h"
 #include <fstream>
 #include <iostream>
 
@@ -23,6 +26,41 @@ json getDefault()
 		{"brt_threshold", 8},
 		{"brt_polling_rate", 100},
 		{"brt_extend", false},
+		{"brt_metric", LUMA_MEAN},
+		{"brt_percentile", 75.0},
+		{"brt_highlight_weight", 3.0},
+		{"brt_region", REGION_FULL},
+		{"brt_filter", FILTER_ONE_EURO},
+		{"brt_filter_tau", 0.5},
+		{"brt_filter_cutoff", 0.5},
+		{"brt_filter_beta", 0.05},
+		{"brt_filter_window", 5},
+		{"brt_media_policy", MEDIA_FREEZE},
+		{"brt_media_rate_mult", 10},
+		{"brt_media_tau", 60.0},
+		{"brt_capture_buffers", 2},
+		{"brt_capture_budget", 0},
+		{"brt_capture_strips", 0},
+		{"brt_samples", 1024},
+
+		{"backlight", false},
+		{"backlight_path", "/sys/class/backlight"},
+		{"backlight_device", ""},
+		{"backlight_min", 0.1},
+		{"backlight_steps", 20},
+		{"backlight_interval", 100},
+
+		{"als", false},
+		{"als_path", "/sys/bus/iio/devices"},
+		{"als_dev_path", "/dev"},
+		{"als_interval", 1000},
+		{"als_lux_max", 1000.0},
+		{"als_weight", 1.0},
+
+		{"drm_device", "/dev/dri/card0"},
+
+		{"gamma_calibration", CALIBRATION_INITIAL},
+		{"gamma_icc_path", ""},
 
 		{"temp_auto", false},
 		{"temp_fps", 45},
@@ -32,6 +70,10 @@ json getDefault()
 		{"temp_speed", 60.0},
 		{"temp_sunrise", "06:00:00"},
 		{"temp_sunset", "16:00:00"},
+		{"temp_schedule", SCHEDULE_FIXED},
+		{"temp_lat", 0.0},
+		{"temp_lon", 0.0},
+		{"temp_keyframes", json::array()},
 
 		{"log_level", plog::warning},
 		{"wnd_show_on_startup", false},
@@ -0,0 +1,89 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef COLORTEMP_H
+#define COLORTEMP_H
+
+#include <array>
+#include <cstddef>
+#include "defs.h"
+
+/**
+ * Temperature step to kelvin: step 0 is temp_k_min (6500K),
+ * temp_steps_max is temp_k_max (2000K).
+ */
+constexpr double stepToKelvin(double step)
+{
+	return temp_k_min - step * (temp_k_min - temp_k_max) / temp_steps_max;
+}
+
+/**
+ * RGB multipliers for every temperature step, linearly interpolated
+ * between the 100K rows of ingo_thies_table. Built at compile time.
+ */
+constexpr std::array<double, (temp_steps_max + 1) * 3> makeTempTable()
+{
+	constexpr int rows = int(ingo_thies_table.size() / 3);
+
+	std::array<double, (temp_steps_max + 1) * 3> t {};
+
+	for (int s = 0; s <= temp_steps_max; ++s) {
+
+		const double row = (stepToKelvin(s) - temp_k_max) / 100;
+
+		int i = int(row);
+		if (i >= rows - 1)
+			i = rows - 2;
+
+		const double x = row - i;
+
+		for (int c = 0; c < 3; ++c) {
+			const double a = ingo_thies_table[i * 3 + c];
+			const double b = ingo_thies_table[(i + 1) * 3 + c];
+			t[s * 3 + c] = a + x * (b - a);
+		}
+	}
+
+	return t;
+}
+
+inline constexpr auto temp_table = makeTempTable();
+
+/**
+ * Every 100 steps is a multiple of 900K, so those steps land exactly
+ * on a row of the reference table and must reproduce it.
+ */
+constexpr bool tempTableOnRows()
+{
+	for (int s = 0; s <= temp_steps_max; s += 100) {
+
+		const int row = int((stepToKelvin(s) - temp_k_max) / 100);
+
+		for (int c = 0; c < 3; ++c) {
+			const double d = temp_table[s * 3 + c] - ingo_thies_table[row * 3 + c];
+
+			if (d > 1e-12 || d < -1e-12)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static_assert(temp_table[0] == 1 && temp_table[1] == 1 && temp_table[2] == 1, "6500K must be neutral");
+static_assert(temp_table[temp_steps_max * 3] == ingo_thies_table[0], "2000K must be the first row");
+static_assert(tempTableOnRows(), "The temperature table doesn't match ingo_thies_table");
+
+inline double tempMultiplier(int temp_step, size_t color_ch)
+{
+	if (temp_step < 0)
+		temp_step = 0;
+	else if (temp_step > temp_steps_max)
+		temp_step = temp_steps_max;
+
+	return temp_table[temp_step * 3 + color_ch];
+}
+
+#endif // COLORTEMP_H
@@ -23,6 +23,11 @@ public:
 		AUTO_BRT_TOGGLED,
 		AUTO_TEMP_TOGGLED,
 		SYSTEM_WAKE_UP,
+		SYSTEM_SLEEP,
+		SESSION_LOCKED,
+		SESSION_UNLOCKED,
+		IDLE_INHIBITED,
+		IDLE_UNINHIBITED,
 		APP_QUIT,
 		APP_QUIT_PURE_GAMMA,
 	};
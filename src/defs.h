@@ -26,6 +26,25 @@ constexpr int temp_steps_max = 500;
 constexpr int temp_k_min     = 6500;
 constexpr int temp_k_max     = 2000;
 
+/* What to do with auto brightness while a fullscreen window is focused
+ * or the screensaver is inhibited. Stored in the config as "brt_media_policy". */
+enum MediaPolicy {
+	MEDIA_IGNORE,
+	MEDIA_FREEZE,       // Stop capturing, keep the current step
+	MEDIA_SLOW_AVERAGE, // Capture at a lower rate and follow a long average
+	MEDIA_LOW_RATE,     // Capture at a lower rate
+	MEDIA_POLICY_COUNT
+};
+
+/* Base curve the brightness/temperature transform is applied on.
+ * Stored in the config as "gamma_calibration". */
+enum GammaCalibration {
+	CALIBRATION_LINEAR,
+	CALIBRATION_INITIAL, // Ramp found on startup, e.g. loaded by colord or xcalib
+	CALIBRATION_ICC,     // VCGT tag of the ICC profile in "gamma_icc_path"
+	CALIBRATION_COUNT
+};
+
 /* Color ramp by Ingo Thies. From Redshift:
  * https://github.com/jonls/redshift/blob/master/README-colorramp */
 constexpr std::array<double, 46 * 3> ingo_thies_table {
@@ -0,0 +1,299 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include "dspctl-drm.h"
+#include "defs.h"
+#include "cfg.h"
+#include "ramp.h"
+#include "icc.h"
+
+Drm::Drm()
+{
+	const std::string path = cfg["drm_device"];
+
+	fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+
+	if (fd == -1) {
+		LOGF << "Unable to open " << path << ": " << strerror(errno);
+		exit(1);
+	}
+
+	atomic = drmSetClientCap(fd, DRM_CLIENT_CAP_ATOMIC, 1) == 0;
+
+	LOGI << "DRM device: " << path << (atomic ? " (atomic)" : " (legacy)");
+
+	queryCrtcs();
+
+	if (crtcs.empty()) {
+		LOGF << "No active CRTCs with gamma support";
+		exit(1);
+	}
+}
+
+Drm::~Drm()
+{
+	if (fd != -1)
+		close(fd);
+}
+
+void Drm::queryCrtcs()
+{
+	drmModeRes *res = drmModeGetResources(fd);
+
+	if (!res) {
+		LOGF << "drmModeGetResources failed";
+		exit(1);
+	}
+
+	for (int i = 0; i < res->count_crtcs; ++i) {
+
+		drmModeCrtc *crtc = drmModeGetCrtc(fd, res->crtcs[i]);
+
+		if (!crtc)
+			continue;
+
+		const bool usable = crtc->mode_valid && crtc->gamma_size > 0;
+		Crtc c { crtc->crtc_id, crtc->gamma_size, crtc->gamma_size, 0, {}, {}, {} };
+
+		drmModeFreeCrtc(crtc);
+
+		if (!usable)
+			continue;
+
+		if (atomic) {
+			drmModeObjectProperties *props = drmModeObjectGetProperties(fd, c.id, DRM_MODE_OBJECT_CRTC);
+
+			for (uint32_t j = 0; props && j < props->count_props; ++j) {
+				drmModePropertyRes *p = drmModeGetProperty(fd, props->props[j]);
+
+				if (!p)
+					continue;
+
+				if (std::strcmp(p->name, "GAMMA_LUT") == 0)
+					c.lut_prop = p->prop_id;
+				else if (std::strcmp(p->name, "GAMMA_LUT_SIZE") == 0)
+					c.lut_size = int(props->prop_values[j]);
+
+				drmModeFreeProperty(p);
+			}
+
+			drmModeFreeObjectProperties(props);
+		}
+
+		c.ramp.resize(3 * c.lut_size);
+		c.init_ramp.resize(3 * c.lut_size);
+
+		// The legacy ramp can be read on atomic drivers too, at the legacy size
+		const int sz = c.legacy_size;
+		std::vector<uint16_t> init(3 * sz);
+
+		if (drmModeCrtcGetGamma(fd, c.id, sz, &init[0], &init[sz], &init[2 * sz]) == 0)
+			resampleRamp(init.data(), sz, c.init_ramp.data(), c.lut_size);
+		else
+			fillGammaRamp(&c.init_ramp[0], &c.init_ramp[c.lut_size], &c.init_ramp[2 * c.lut_size], c.lut_size, brt_steps_max, 0);
+
+		loadCalibration(c);
+
+		LOGD << "CRTC " << c.id << ": " << c.lut_size << " entries" << (c.lut_prop ? ", GAMMA_LUT" : "");
+
+		crtcs.push_back(std::move(c));
+	}
+
+	drmModeFreeResources(res);
+}
+
+/**
+ * Same as Vidmode::loadCalibration, per CRTC.
+ */
+void Drm::loadCalibration(Crtc &c)
+{
+	switch (cfg["gamma_calibration"].get<int>()) {
+	case CALIBRATION_INITIAL:
+		if (rampSane(c.init_ramp.data(), c.lut_size))
+			c.base = c.init_ramp;
+		break;
+	case CALIBRATION_ICC: {
+		std::vector<uint16_t> vcgt;
+		if (loadVcgt(cfg["gamma_icc_path"], c.lut_size, vcgt) && rampSane(vcgt.data(), c.lut_size))
+			c.base = std::move(vcgt);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+/**
+ * All CRTCs with a GAMMA_LUT in a single commit. The blobs can be destroyed
+ * right away: the committed state keeps its own reference.
+ * Returns 0 or a negative errno.
+ */
+int Drm::commitAtomic()
+{
+	drmModeAtomicReq *req = drmModeAtomicAlloc();
+
+	std::vector<uint32_t>      blobs;
+	std::vector<drm_color_lut> lut;
+
+	int r = 0;
+
+	for (const auto &c : crtcs) {
+		if (!c.lut_prop)
+			continue;
+
+		lut.resize(c.lut_size);
+
+		for (int i = 0; i < c.lut_size; ++i)
+			lut[i] = { c.ramp[i], c.ramp[c.lut_size + i], c.ramp[2 * c.lut_size + i], 0 };
+
+		uint32_t blob;
+
+		if ((r = drmModeCreatePropertyBlob(fd, lut.data(), lut.size() * sizeof(drm_color_lut), &blob)) != 0)
+			break;
+
+		blobs.push_back(blob);
+		drmModeAtomicAddProperty(req, c.id, c.lut_prop, blob);
+	}
+
+	if (r == 0 && !blobs.empty())
+		r = drmModeAtomicCommit(fd, req, 0, nullptr);
+
+	for (uint32_t b : blobs)
+		drmModeDestroyPropertyBlob(fd, b);
+
+	drmModeAtomicFree(req);
+
+	if (r != 0) {
+		LOGD << "Atomic gamma commit failed: " << strerror(-r);
+	}
+
+	return r;
+}
+
+void Drm::setLegacy(bool without_lut_only)
+{
+	std::vector<uint16_t> tmp;
+
+	for (auto &c : crtcs) {
+		if (without_lut_only && c.lut_prop)
+			continue;
+
+		const int sz = c.legacy_size;
+		uint16_t  *r = c.ramp.data();
+
+		// GAMMA_LUT_SIZE can differ from the legacy size
+		if (sz != c.lut_size) {
+			tmp.resize(3 * sz);
+			resampleRamp(c.ramp.data(), c.lut_size, tmp.data(), sz);
+			r = tmp.data();
+		}
+
+		if (drmModeCrtcSetGamma(fd, c.id, sz, &r[0], &r[sz], &r[2 * sz]) != 0) {
+			LOGD << "drmModeCrtcSetGamma failed on CRTC " << c.id << ": " << strerror(errno);
+		}
+	}
+}
+
+void Drm::setGamma(int brt, int temp)
+{
+	std::lock_guard lock(mtx);
+
+	for (auto &c : crtcs) {
+		uint16_t *r = c.ramp.data();
+		const int sz = c.lut_size;
+
+		if (c.base.empty())
+			fillGammaRamp(&r[0], &r[sz], &r[2 * sz], sz, brt, temp);
+		else
+			composeGammaRamp(&r[0], &r[sz], &r[2 * sz], c.base.data(), sz, brt, temp);
+	}
+
+	upload();
+}
+
+/**
+ * A failed commit (e.g. EBUSY during a modeset) falls back to legacy gamma
+ * for that frame. It's given up for the session only when the driver
+ * rejects the commit itself.
+ */
+void Drm::upload()
+{
+	if (!atomic) {
+		setLegacy(false);
+		return;
+	}
+
+	const int r = commitAtomic();
+
+	if (r == 0) {
+		setLegacy(true);
+		return;
+	}
+
+	if (r == -EINVAL || r == -EOPNOTSUPP) {
+		LOGW << "Atomic gamma failed, using legacy gamma";
+		atomic = false;
+	}
+
+	setLegacy(false);
+}
+
+void Drm::setInitialGamma(bool set_previous)
+{
+	if (!set_previous) {
+		LOGI << "Setting pure gamma";
+		setGamma(brt_steps_max, 0);
+		return;
+	}
+
+	LOGI << "Setting previous gamma";
+
+	std::lock_guard lock(mtx);
+
+	for (auto &c : crtcs)
+		c.ramp = c.init_ramp;
+
+	upload();
+}
+
+int Drm::getScreenBrightness() noexcept
+{
+	return 0;
+}
+
+bool Drm::captureSupported() const
+{
+	return false;
+}
+
+void Drm::discardCapture()
+{
+}
+
+bool Drm::screenActive()
+{
+	return true;
+}
+
+bool Drm::fullscreenActive() const
+{
+	return false;
+}
+
+/**
+ * There are no windows to track: just sleeps.
+ */
+bool Drm::waitForEvent(int timeout_ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+	return false;
+}
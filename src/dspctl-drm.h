@@ -0,0 +1,63 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef DRM_H
+#define DRM_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Sets the gamma through DRM/KMS ("drm_device", /dev/dri/card0 by default),
+ * for sessions without an X server, like the console.
+ * With atomic modesetting, the GAMMA_LUT of every active CRTC is set
+ * in one commit per frame. CRTCs without one, and all of them without
+ * atomic support, get their legacy gamma set.
+ * Either way we need to be DRM master: it won't work while
+ * a compositor is running on the device.
+ * There's no screen capture: auto brightness needs the X11 backends.
+ */
+class Drm
+{
+public:
+	Drm();
+	~Drm();
+	int  getScreenBrightness() noexcept;
+	bool captureSupported() const;
+	void discardCapture();
+	bool screenActive();
+	bool fullscreenActive() const;
+	bool waitForEvent(int timeout_ms);
+	void setGamma(int brt, int temp);
+	void setInitialGamma(bool set_previous);
+private:
+	struct Crtc {
+		uint32_t id;
+		int      lut_size;
+		int      legacy_size;
+		uint32_t lut_prop = 0;     // GAMMA_LUT, 0 without atomic support
+		std::vector<uint16_t> ramp; // R, G, B
+		std::vector<uint16_t> init_ramp;
+		std::vector<uint16_t> base; // Calibration curve, empty when linear
+	};
+
+	int  fd     = -1;
+	bool atomic = false;
+
+	std::vector<Crtc> crtcs;
+	std::mutex        mtx;
+
+	void queryCrtcs();
+	void loadCalibration(Crtc &c);
+	int  commitAtomic();
+	void setLegacy(bool without_lut_only);
+	void upload();
+};
+
+typedef Drm DspCtl;
+
+#endif // DRM_H
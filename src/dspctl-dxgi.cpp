@@ -7,6 +7,7 @@
 #include "defs.h"
 #include "cfg.h"
 #include "utils.h"
+#include "ramp.h"
 
 GDI::GDI()
 {
@@ -60,31 +61,14 @@ void GDI::createDCs(const std::wstring &primary_screen_name)
 
 void GDI::setGamma(int brt_step, int temp_step)
 {
-	const double r_mult = interpTemp(temp_step, 0),
-	             g_mult = interpTemp(temp_step, 1),
-	             b_mult = interpTemp(temp_step, 2);
-
 	WORD ramp[3][256];
-	const double brt_mult = remap(brt_step, 0, brt_steps_max, 0, 255);
-
-	for (WORD i = 0; i < 256; ++i) {
-		const int val = i * brt_mult;
-		ramp[0][i] = WORD(val * r_mult);
-		ramp[1][i] = WORD(val * g_mult);
-		ramp[2][i] = WORD(val * b_mult);
-	}
+	fillGammaRamp(ramp[0], ramp[1], ramp[2], 256, brt_step, temp_step);
 
 	/* As auto brt is currently supported only on the primary screen,
 	 * We set this ramp to the screens whose image brightness is not controlled. */
 	WORD ramp_full_brt[3][256];
-	if (hdcs.size() > 1) {
-		for (WORD i = 0; i < 256; ++i) {
-			const int val = i * 255;
-			ramp_full_brt[0][i] = WORD(val * r_mult);
-			ramp_full_brt[1][i] = WORD(val * g_mult);
-			ramp_full_brt[2][i] = WORD(val * b_mult);
-		}
-	}
+	if (hdcs.size() > 1)
+		fillGammaRamp(ramp_full_brt[0], ramp_full_brt[1], ramp_full_brt[2], 256, brt_steps_max, temp_step);
 
 	int i = 0;
 	for (const auto &dc : hdcs) {
@@ -119,6 +103,33 @@ void GDI::setBitmapInfo(int width, int height)
 	info.biClrImportant = 0;
 }
 
+bool GDI::captureSupported() const
+{
+	return true;
+}
+
+void GDI::discardCapture()
+{
+}
+
+bool GDI::screenActive()
+{
+	return true;
+}
+
+bool GDI::fullscreenActive() const
+{
+	return false;
+}
+
+/**
+ * No focus tracking. The polling interval is slept in getScreenBrightness().
+ */
+bool GDI::waitForEvent([[maybe_unused]] int timeout_ms)
+{
+	return false;
+}
+
 int GDI::getScreenBrightness() noexcept
 {
 	HDC     dc  = GetDC(NULL);
@@ -135,7 +146,7 @@ int GDI::getScreenBrightness() noexcept
 	DeleteDC(tmp);
 	DeleteDC(dc);
 
-	return calcBrightness(buf.data(), buf.size(), 4, 1024);
+	return calcBrightness(buf.data(), width, height, width * 4);
 }
 
 DXGI::DXGI()
@@ -322,7 +333,7 @@ int  DXGI::getScreenBrightness()
 	staging_tex->Release();
 	d3d_context->Release();
 
-	return calcBrightness(reinterpret_cast<uint8_t*>(map.pData), map.DepthPitch, 4, 1024);
+	return calcBrightness(reinterpret_cast<uint8_t*>(map.pData), int(tex_desc.Width), int(tex_desc.Height), int(map.RowPitch));
 }
 
 void DXGI::restart()
@@ -27,6 +27,11 @@ public:
 	~GDI();
 
 	int  getScreenBrightness() noexcept;
+	bool captureSupported() const;
+	void discardCapture();
+	bool screenActive();
+	bool fullscreenActive() const;
+	bool waitForEvent(int timeout_ms);
 	void setGamma(int brt, int temp);
 	void setInitialGamma(bool set_previous);
 protected:
@@ -0,0 +1,596 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include "dspctl-wayland.h"
+#include "defs.h"
+#include "cfg.h"
+#include "luma.h"
+#include "sampler.h"
+#include "utils.h"
+#include "ramp.h"
+#include "icc.h"
+
+const wl_registry_listener Wayland::registry_listener {
+	Wayland::onGlobal,
+	Wayland::onGlobalRemove,
+};
+
+const zwlr_gamma_control_v1_listener Wayland::gamma_listener {
+	Wayland::onGammaSize,
+	Wayland::onGammaFailed,
+};
+
+const zwlr_screencopy_frame_v1_listener Wayland::frame_listener {
+	Wayland::onBuffer,
+	Wayland::onFlags,
+	Wayland::onReady,
+	Wayland::onFailed,
+	Wayland::onDamage,
+	Wayland::onDmabuf,
+	Wayland::onBufferDone,
+};
+
+static int createMemfd(const char *name, size_t size)
+{
+	const int fd = memfd_create(name, MFD_CLOEXEC);
+
+	if (fd == -1)
+		return -1;
+
+	if (ftruncate(fd, off_t(size)) == -1) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+Wayland::Wayland()
+{
+	dsp = wl_display_connect(nullptr);
+
+	if (!dsp) {
+		LOGF << "Unable to connect to the Wayland display";
+		exit(1);
+	}
+
+	registry = wl_display_get_registry(dsp);
+	wl_registry_add_listener(registry, &registry_listener, this);
+
+	// Globals, then the gamma sizes of the outputs
+	wl_display_roundtrip(dsp);
+	wl_display_roundtrip(dsp);
+
+	if (!gamma_mgr) {
+		LOGF << "The compositor doesn't support wlr-gamma-control";
+		exit(1);
+	}
+
+	if (copy_mgr && shm) {
+		cap_queue    = wl_display_create_queue(dsp);
+		copy_wrapper = static_cast<zwlr_screencopy_manager_v1*>(wl_proxy_create_wrapper(copy_mgr));
+		wl_proxy_set_queue(reinterpret_cast<wl_proxy*>(copy_wrapper), cap_queue);
+	} else {
+		LOGW << "The compositor doesn't support wlr-screencopy. Auto brightness is unavailable.";
+	}
+
+	LOGI << "Wayland outputs: " << outputs.size();
+
+	quit_fd = eventfd(0, EFD_CLOEXEC);
+
+	if (quit_fd == -1) {
+		LOGF << "eventfd failed";
+		exit(1);
+	}
+
+	event_thread = std::thread([this] { dispatchEvents(); });
+}
+
+Wayland::~Wayland()
+{
+	const uint64_t one = 1;
+
+	if (write(quit_fd, &one, sizeof(one)) != sizeof(one))
+		LOGE << "Unable to stop the Wayland event thread";
+
+	if (event_thread.joinable())
+		event_thread.join();
+
+	close(quit_fd);
+
+	destroyShotBuffer();
+	destroyGamma();
+
+	for (auto &o : outputs)
+		wl_output_destroy(o->output);
+
+	if (copy_wrapper)
+		wl_proxy_wrapper_destroy(copy_wrapper);
+
+	if (copy_mgr)
+		zwlr_screencopy_manager_v1_destroy(copy_mgr);
+
+	if (gamma_mgr)
+		zwlr_gamma_control_manager_v1_destroy(gamma_mgr);
+
+	if (cap_queue)
+		wl_event_queue_destroy(cap_queue);
+
+	if (shm)
+		wl_shm_destroy(shm);
+
+	wl_registry_destroy(registry);
+	wl_display_disconnect(dsp);
+}
+
+/**
+ * The only reader of the default queue: gamma "failed" events and
+ * output hot-plugs are handled as they arrive, whether or not
+ * anything else is talking to the compositor.
+ * The capture thread reads its own queue concurrently:
+ * libwayland hands each one its own events.
+ */
+void Wayland::dispatchEvents()
+{
+	pollfd fds[] {
+		{ wl_display_get_fd(dsp), POLLIN, 0 },
+		{ quit_fd,                POLLIN, 0 },
+	};
+
+	while (true) {
+		while (wl_display_prepare_read(dsp) != 0)
+			wl_display_dispatch_pending(dsp);
+
+		wl_display_flush(dsp);
+
+		if (poll(fds, 2, -1) == -1) {
+			wl_display_cancel_read(dsp);
+
+			if (errno == EINTR)
+				continue;
+
+			LOGE << "Wayland event poll failed: " << strerror(errno);
+			break;
+		}
+
+		if (fds[1].revents) {
+			wl_display_cancel_read(dsp);
+			break;
+		}
+
+		if (!(fds[0].revents & POLLIN)) {
+			wl_display_cancel_read(dsp);
+			LOGE << "Wayland connection lost";
+			break;
+		}
+
+		if (wl_display_read_events(dsp) == -1 || wl_display_dispatch_pending(dsp) == -1) {
+			LOGE << "Wayland connection lost";
+			break;
+		}
+	}
+}
+
+void Wayland::onGlobal(void *data, wl_registry *reg, uint32_t name, const char *iface, uint32_t version)
+{
+	auto wl = static_cast<Wayland*>(data);
+
+	if (std::strcmp(iface, wl_output_interface.name) == 0) {
+
+		auto o    = std::make_unique<Output>();
+		o->wl     = wl;
+		o->name   = name;
+		o->output = static_cast<wl_output*>(wl_registry_bind(reg, name, &wl_output_interface, 1));
+
+		if (wl->gamma_mgr) {
+			o->gamma = zwlr_gamma_control_manager_v1_get_gamma_control(wl->gamma_mgr, o->output);
+			zwlr_gamma_control_v1_add_listener(o->gamma, &gamma_listener, o.get());
+		}
+
+		std::lock_guard lock(wl->outputs_mtx);
+		wl->outputs.push_back(std::move(o));
+
+	} else if (std::strcmp(iface, wl_shm_interface.name) == 0) {
+
+		wl->shm = static_cast<wl_shm*>(wl_registry_bind(reg, name, &wl_shm_interface, 1));
+
+	} else if (std::strcmp(iface, zwlr_gamma_control_manager_v1_interface.name) == 0) {
+
+		wl->gamma_mgr = static_cast<zwlr_gamma_control_manager_v1*>(wl_registry_bind(reg, name, &zwlr_gamma_control_manager_v1_interface, 1));
+
+		std::lock_guard lock(wl->outputs_mtx);
+
+		// Outputs announced before the manager
+		for (auto &o : wl->outputs) {
+			if (!o->gamma) {
+				o->gamma = zwlr_gamma_control_manager_v1_get_gamma_control(wl->gamma_mgr, o->output);
+				zwlr_gamma_control_v1_add_listener(o->gamma, &gamma_listener, o.get());
+			}
+		}
+
+	} else if (std::strcmp(iface, zwlr_screencopy_manager_v1_interface.name) == 0) {
+
+		wl->copy_version = std::min(version, 3u);
+		wl->copy_mgr     = static_cast<zwlr_screencopy_manager_v1*>(wl_registry_bind(reg, name, &zwlr_screencopy_manager_v1_interface, wl->copy_version));
+	}
+}
+
+void Wayland::onGlobalRemove(void *data, [[maybe_unused]] wl_registry *reg, uint32_t name)
+{
+	auto wl = static_cast<Wayland*>(data);
+
+	std::lock_guard lock(wl->outputs_mtx);
+
+	auto &v = wl->outputs;
+
+	for (auto it = v.begin(); it != v.end(); ++it) {
+		Output &o = **it;
+
+		if (o.name != name)
+			continue;
+
+		if (o.gamma)
+			zwlr_gamma_control_v1_destroy(o.gamma);
+
+		if (o.ramp)
+			munmap(o.ramp, size_t(o.ramp_sz) * 3 * sizeof(uint16_t));
+
+		if (o.ramp_fd != -1)
+			close(o.ramp_fd);
+
+		wl_output_destroy(o.output);
+		v.erase(it);
+		break;
+	}
+}
+
+void Wayland::onGammaSize(void *data, [[maybe_unused]] zwlr_gamma_control_v1 *ctrl, uint32_t size)
+{
+	auto o = static_cast<Output*>(data);
+
+	std::lock_guard lock(o->wl->outputs_mtx);
+	o->wl->createRamp(*o, size);
+}
+
+void Wayland::onGammaFailed(void *data, [[maybe_unused]] zwlr_gamma_control_v1 *ctrl)
+{
+	auto o = static_cast<Output*>(data);
+
+	std::lock_guard lock(o->wl->outputs_mtx);
+	o->failed = true;
+	LOGE << "Gamma control failed on output " << o->name << ". Is another program controlling it?";
+}
+
+/**
+ * The memfd is created once per output. The ramps are written in place,
+ * and the same fd is sent again on each change.
+ * The calibration is loaded here too, so each step is just a scale.
+ */
+void Wayland::createRamp(Output &o, uint32_t size)
+{
+	const size_t bytes = size_t(size) * 3 * sizeof(uint16_t);
+
+	o.ramp_fd = createMemfd("gammy-ramp", bytes);
+
+	if (o.ramp_fd == -1) {
+		LOGE << "Unable to create the gamma ramp memfd";
+		return;
+	}
+
+	void *map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, o.ramp_fd, 0);
+
+	if (map == MAP_FAILED) {
+		LOGE << "Unable to map the gamma ramp";
+		close(o.ramp_fd);
+		o.ramp_fd = -1;
+		return;
+	}
+
+	o.ramp    = static_cast<uint16_t*>(map);
+	o.ramp_sz = int(size);
+
+	LOGD << "Output " << o.name << " gamma size: " << size;
+
+	// The initial ramps can't be read on Wayland: only an ICC profile can be used
+	if (cfg["gamma_calibration"].get<int>() == CALIBRATION_ICC) {
+		std::vector<uint16_t> vcgt;
+
+		if (loadVcgt(cfg["gamma_icc_path"], o.ramp_sz, vcgt) && rampSane(vcgt.data(), o.ramp_sz))
+			o.base = std::move(vcgt);
+	}
+}
+
+/**
+ * Destroying the gamma controls makes the compositor restore the original gamma.
+ */
+void Wayland::destroyGamma()
+{
+	std::lock_guard lock(outputs_mtx);
+
+	for (auto &o : outputs) {
+		if (o->gamma) {
+			zwlr_gamma_control_v1_destroy(o->gamma);
+			o->gamma = nullptr;
+		}
+
+		if (o->ramp) {
+			munmap(o->ramp, size_t(o->ramp_sz) * 3 * sizeof(uint16_t));
+			o->ramp = nullptr;
+		}
+
+		if (o->ramp_fd != -1) {
+			close(o->ramp_fd);
+			o->ramp_fd = -1;
+		}
+	}
+
+	wl_display_flush(dsp);
+}
+
+void Wayland::setGamma(int brt, int temp)
+{
+	{
+		std::lock_guard lock(outputs_mtx);
+
+		for (auto &o : outputs) {
+
+			if (!o->gamma || !o->ramp || o->failed)
+				continue;
+
+			const int sz = o->ramp_sz;
+			uint16_t  *r = o->ramp;
+
+			if (o->base.empty())
+				fillGammaRamp(&r[0], &r[sz], &r[2 * sz], sz, brt, temp);
+			else
+				composeGammaRamp(&r[0], &r[sz], &r[2 * sz], o->base.data(), sz, brt, temp);
+
+			// The compositor reads the fd from its current offset
+			lseek(o->ramp_fd, 0, SEEK_SET);
+			zwlr_gamma_control_v1_set_gamma(o->gamma, o->ramp_fd);
+		}
+
+		// Replies are handled by the event thread
+		wl_display_flush(dsp);
+	}
+}
+
+void Wayland::setInitialGamma(bool set_previous)
+{
+	if (set_previous) {
+		LOGI << "Restoring gamma";
+		destroyGamma();
+	} else {
+		LOGI << "Setting pure gamma";
+		setGamma(brt_steps_max, 0);
+	}
+}
+
+bool Wayland::createShotBuffer(uint32_t format, uint32_t width, uint32_t height, uint32_t stride)
+{
+	if (shot.buffer && shot.format == format && shot.width == width && shot.height == height && shot.stride == stride)
+		return true;
+
+	destroyShotBuffer();
+
+	const size_t size = size_t(stride) * height;
+
+	shot.fd = createMemfd("gammy-capture", size);
+
+	if (shot.fd == -1)
+		return false;
+
+	void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, shot.fd, 0);
+
+	if (map == MAP_FAILED) {
+		close(shot.fd);
+		shot.fd = -1;
+		return false;
+	}
+
+	wl_shm_pool *pool = wl_shm_create_pool(shm, shot.fd, int32_t(size));
+	shot.buffer = wl_shm_pool_create_buffer(pool, 0, int32_t(width), int32_t(height), int32_t(stride), format);
+	wl_shm_pool_destroy(pool);
+
+	shot.data   = static_cast<uint8_t*>(map);
+	shot.size   = size;
+	shot.format = format;
+	shot.width  = width;
+	shot.height = height;
+	shot.stride = stride;
+
+	switch (format) {
+	case WL_SHM_FORMAT_ARGB8888:
+	case WL_SHM_FORMAT_XRGB8888:
+		shot.pixfmt = pixelFormat(32, 0xff0000, 0xff00, 0xff, false);
+		break;
+	case WL_SHM_FORMAT_ABGR8888:
+	case WL_SHM_FORMAT_XBGR8888:
+		shot.pixfmt = pixelFormat(32, 0xff, 0xff00, 0xff0000, false);
+		break;
+	case WL_SHM_FORMAT_ARGB2101010:
+	case WL_SHM_FORMAT_XRGB2101010:
+		shot.pixfmt = pixelFormat(32, 0x3ff00000, 0xffc00, 0x3ff, false);
+		break;
+	case WL_SHM_FORMAT_ABGR2101010:
+	case WL_SHM_FORMAT_XBGR2101010:
+		shot.pixfmt = pixelFormat(32, 0x3ff, 0xffc00, 0x3ff00000, false);
+		break;
+	case WL_SHM_FORMAT_RGB565:
+		shot.pixfmt = pixelFormat(16, 0xf800, 0x7e0, 0x1f, false);
+		break;
+	default:
+		LOGW << "Unknown shm format: " << std::hex << format << ". Assuming XRGB8888.";
+		shot.pixfmt = pixelFormat(32, 0xff0000, 0xff00, 0xff, false);
+	}
+
+	LOGD << "Capture buffer: " << width << '*' << height << ", " << shot.pixfmt.name << " (" << size / 1024 << " KiB)";
+
+	return true;
+}
+
+void Wayland::destroyShotBuffer()
+{
+	if (shot.buffer)
+		wl_buffer_destroy(shot.buffer);
+
+	if (shot.data)
+		munmap(shot.data, shot.size);
+
+	if (shot.fd != -1)
+		close(shot.fd);
+
+	shot = Shot();
+}
+
+void Wayland::copyFrame(zwlr_screencopy_frame_v1 *frame)
+{
+	if (!createShotBuffer(shot.format, shot.width, shot.height, shot.stride)) {
+		shot.failed = true;
+		return;
+	}
+
+	zwlr_screencopy_frame_v1_copy(frame, shot.buffer);
+}
+
+void Wayland::onBuffer(void *data, zwlr_screencopy_frame_v1 *frame, uint32_t format, uint32_t width, uint32_t height, uint32_t stride)
+{
+	auto wl = static_cast<Wayland*>(data);
+	Shot &s = wl->shot;
+
+	// The buffer is kept until the output's format or size changes
+	if (s.format != format || s.width != width || s.height != height || s.stride != stride) {
+		wl->destroyShotBuffer();
+		s.format = format;
+		s.width  = width;
+		s.height = height;
+		s.stride = stride;
+	}
+
+	s.got_buffer = true;
+
+	// Before v3 there's no buffer_done: this is the only buffer type
+	if (wl->copy_version < 3)
+		wl->copyFrame(frame);
+}
+
+void Wayland::onBufferDone(void *data, zwlr_screencopy_frame_v1 *frame)
+{
+	auto wl = static_cast<Wayland*>(data);
+
+	if (!wl->shot.got_buffer) {
+		LOGE << "No shm buffer offered for screencopy";
+		wl->shot.failed = true;
+		return;
+	}
+
+	wl->copyFrame(frame);
+}
+
+void Wayland::onReady(void *data, [[maybe_unused]] zwlr_screencopy_frame_v1 *frame, uint32_t, uint32_t, uint32_t)
+{
+	static_cast<Wayland*>(data)->shot.done = true;
+}
+
+void Wayland::onFailed(void *data, [[maybe_unused]] zwlr_screencopy_frame_v1 *frame)
+{
+	static_cast<Wayland*>(data)->shot.failed = true;
+}
+
+void Wayland::onFlags(void*, zwlr_screencopy_frame_v1*, uint32_t) {}
+void Wayland::onDamage(void*, zwlr_screencopy_frame_v1*, uint32_t, uint32_t, uint32_t, uint32_t) {}
+void Wayland::onDmabuf(void*, zwlr_screencopy_frame_v1*, uint32_t, uint32_t, uint32_t) {}
+
+/**
+ * Captures the first output. Like the other backends, it's reduced with
+ * samplePixels(): "brt_samples" pixels on a scrambled Halton sequence,
+ * or every 1024th one when that's 0.
+ */
+int Wayland::getScreenBrightness() noexcept
+{
+	if (!copy_wrapper)
+		return 0;
+
+	shot.got_buffer = shot.done = shot.failed = false;
+
+	zwlr_screencopy_frame_v1 *frame;
+
+	{
+		// The output can't be removed while the request is being made
+		std::lock_guard lock(outputs_mtx);
+
+		if (outputs.empty())
+			return 0;
+
+		frame = zwlr_screencopy_manager_v1_capture_output(copy_wrapper, 0, outputs.front()->output);
+	}
+
+	zwlr_screencopy_frame_v1_add_listener(frame, &frame_listener, this);
+
+	while (!shot.done && !shot.failed) {
+		if (wl_display_dispatch_queue(dsp, cap_queue) == -1) {
+			shot.failed = true;
+			break;
+		}
+	}
+
+	zwlr_screencopy_frame_v1_destroy(frame);
+
+	if (shot.failed) {
+		LOGD << "Screencopy failed";
+		return 0;
+	}
+
+	const PixelFormat &f = shot.pixfmt;
+	const int w = int(shot.width);
+	const int h = int(shot.height);
+
+	LumaHistogram hist;
+	samplePixels(f, hist, shot.data, w, h, int(shot.stride), 0, h);
+
+	return brightnessMetric(hist);
+}
+
+/**
+ * Without wlr-screencopy there's nothing to sample.
+ */
+bool Wayland::captureSupported() const
+{
+	return copy_wrapper != nullptr;
+}
+
+/**
+ * Frames are waited for in getScreenBrightness(): none is ever in flight.
+ */
+void Wayland::discardCapture()
+{
+}
+
+bool Wayland::screenActive()
+{
+	return true;
+}
+
+bool Wayland::fullscreenActive() const
+{
+	return false;
+}
+
+/**
+ * The wlroots protocols don't expose focus or workspace changes: just sleeps.
+ */
+bool Wayland::waitForEvent(int timeout_ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+	return false;
+}
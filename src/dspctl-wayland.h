@@ -0,0 +1,118 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef WAYLAND_H
+#define WAYLAND_H
+
+#include <wayland-client.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "wlr-gamma-control-unstable-v1-client-protocol.h"
+#include "wlr-screencopy-unstable-v1-client-protocol.h"
+#include "pixfmt.h"
+
+/**
+ * Sets the gamma through wlr-gamma-control and captures the screen
+ * through wlr-screencopy (wlroots based compositors).
+ * Each output has its own memfd for the ramps: it's rewritten in place
+ * and sent again on each change. Captures are copied into a wl_shm buffer
+ * that's kept as long as the output's format and size don't change.
+ * Capture runs on its own event queue, so it never dispatches gamma events.
+ * The default queue (outputs and gamma controls) has a single reader:
+ * a thread that dispatches it as soon as events arrive.
+ */
+class Wayland
+{
+public:
+	Wayland();
+	~Wayland();
+	int  getScreenBrightness() noexcept;
+	bool captureSupported() const;
+	void discardCapture();
+	bool screenActive();
+	bool fullscreenActive() const;
+	bool waitForEvent(int timeout_ms);
+	void setGamma(int brt, int temp);
+	void setInitialGamma(bool set_previous);
+private:
+	struct Output {
+		Wayland               *wl;
+		wl_output             *output;
+		uint32_t              name;
+		zwlr_gamma_control_v1 *gamma   = nullptr;
+		int                   ramp_sz  = 0;
+		int                   ramp_fd  = -1;
+		uint16_t              *ramp    = nullptr; // Mapped memfd, R, G, B
+		bool                  failed   = false;
+		std::vector<uint16_t> base;               // VCGT at ramp_sz, empty when linear
+	};
+
+	struct Shot {
+		wl_buffer   *buffer  = nullptr;
+		int         fd       = -1;
+		uint8_t     *data    = nullptr;
+		size_t      size     = 0;
+		uint32_t    format   = 0;
+		uint32_t    width    = 0;
+		uint32_t    height   = 0;
+		uint32_t    stride   = 0;
+		PixelFormat pixfmt {};
+
+		// State of the frame being captured
+		bool got_buffer = false;
+		bool done       = false;
+		bool failed     = false;
+	};
+
+	wl_display     *dsp       = nullptr;
+	wl_registry    *registry  = nullptr;
+	wl_shm         *shm       = nullptr;
+	wl_event_queue *cap_queue = nullptr;
+
+	zwlr_gamma_control_manager_v1 *gamma_mgr    = nullptr;
+	zwlr_screencopy_manager_v1    *copy_mgr     = nullptr;
+	zwlr_screencopy_manager_v1    *copy_wrapper = nullptr;
+	uint32_t                      copy_version  = 0;
+
+	/* Outputs come and go from the registry listener, which runs on
+	 * the event thread. Every access goes through outputs_mtx,
+	 * and the queue is never dispatched while holding it. */
+	std::vector<std::unique_ptr<Output>> outputs;
+	std::mutex outputs_mtx;
+	Shot       shot;
+
+	std::thread event_thread;
+	int         quit_fd = -1; // eventfd, stops the event thread
+
+	void dispatchEvents();
+	void createRamp(Output &o, uint32_t size);
+	void destroyGamma();
+	bool createShotBuffer(uint32_t format, uint32_t width, uint32_t height, uint32_t stride);
+	void destroyShotBuffer();
+	void copyFrame(zwlr_screencopy_frame_v1 *frame);
+
+	static const wl_registry_listener                registry_listener;
+	static const zwlr_gamma_control_v1_listener      gamma_listener;
+	static const zwlr_screencopy_frame_v1_listener   frame_listener;
+
+	static void onGlobal(void *data, wl_registry *reg, uint32_t name, const char *iface, uint32_t version);
+	static void onGlobalRemove(void *data, wl_registry *reg, uint32_t name);
+	static void onGammaSize(void *data, zwlr_gamma_control_v1 *ctrl, uint32_t size);
+	static void onGammaFailed(void *data, zwlr_gamma_control_v1 *ctrl);
+	static void onBuffer(void *data, zwlr_screencopy_frame_v1 *frame, uint32_t format, uint32_t width, uint32_t height, uint32_t stride);
+	static void onFlags(void *data, zwlr_screencopy_frame_v1 *frame, uint32_t flags);
+	static void onReady(void *data, zwlr_screencopy_frame_v1 *frame, uint32_t sec_hi, uint32_t sec_lo, uint32_t nsec);
+	static void onFailed(void *data, zwlr_screencopy_frame_v1 *frame);
+	static void onDamage(void *data, zwlr_screencopy_frame_v1 *frame, uint32_t x, uint32_t y, uint32_t w, uint32_t h);
+	static void onDmabuf(void *data, zwlr_screencopy_frame_v1 *frame, uint32_t format, uint32_t width, uint32_t height);
+	static void onBufferDone(void *data, zwlr_screencopy_frame_v1 *frame);
+};
+
+typedef Wayland DspCtl;
+
+#endif // WAYLAND_H
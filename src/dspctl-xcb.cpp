@@ -0,0 +1,380 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <chrono>
+#include <algorithm>
+#include "dspctl-xcb.h"
+#include "defs.h"
+#include "utils.h"
+#include "cfg.h"
+#include "ramp.h"
+
+static xcb_screen_t* screenOfDisplay(xcb_connection_t *conn, int scr_num)
+{
+	xcb_screen_iterator_t it = xcb_setup_roots_iterator(xcb_get_setup(conn));
+
+	for (; it.rem; --scr_num, xcb_screen_next(&it)) {
+		if (scr_num == 0)
+			return it.data;
+	}
+
+	return nullptr;
+}
+
+Xcb::Xcb()
+{
+	cap_conn   = xcb_connect(nullptr, &scr_num);
+	gamma_conn = xcb_connect(nullptr, nullptr);
+
+	if (xcb_connection_has_error(cap_conn) || xcb_connection_has_error(gamma_conn)) {
+		LOGF << "xcb_connect failed";
+		exit(1);
+	}
+
+	const xcb_screen_t *scr = screenOfDisplay(cap_conn, scr_num);
+
+	if (!scr) {
+		LOGF << "XCB screen " << scr_num << " not found";
+		exit(1);
+	}
+
+	root = scr->root;
+
+	const auto ver = xcb_shm_query_version_reply(cap_conn, xcb_shm_query_version(cap_conn), nullptr);
+
+	if (!ver) {
+		LOGF << "MIT-SHM unavailable";
+		exit(1);
+	}
+
+	LOGV << "XCB MIT-SHM " << ver->major_version << '.' << ver->minor_version;
+	free(ver);
+
+	createRing(scr_w, scr_h, std::clamp(cfg["brt_capture_buffers"].get<int>(), 2, 3));
+	queryCrtcs();
+}
+
+void Xcb::queryCrtcs()
+{
+	const auto res = xcb_randr_get_screen_resources_current_reply(gamma_conn, xcb_randr_get_screen_resources_current(gamma_conn, root), nullptr);
+
+	if (!res) {
+		LOGE << "Failed to get RandR screen resources";
+		return;
+	}
+
+	const xcb_randr_crtc_t *ids = xcb_randr_get_screen_resources_current_crtcs(res);
+	const int n = xcb_randr_get_screen_resources_current_crtcs_length(res);
+
+	// Send all the requests first, then collect the replies
+	std::vector<xcb_randr_get_crtc_gamma_size_cookie_t> size_cookies(n);
+	std::vector<xcb_randr_get_crtc_gamma_cookie_t>      ramp_cookies(n);
+
+	for (int i = 0; i < n; ++i) {
+		size_cookies[i] = xcb_randr_get_crtc_gamma_size(gamma_conn, ids[i]);
+		ramp_cookies[i] = xcb_randr_get_crtc_gamma(gamma_conn, ids[i]);
+	}
+
+	/* On a re-query, the ramps of known CRTCs are ours by now.
+	 * Their initial ramps are carried over instead. */
+	std::vector<Crtc> prev = std::move(crtcs);
+	crtcs.clear();
+
+	const int calibration = cfg["gamma_calibration"].get<int>();
+
+	for (int i = 0; i < n; ++i) {
+		const auto sz    = xcb_randr_get_crtc_gamma_size_reply(gamma_conn, size_cookies[i], nullptr);
+		const auto gamma = xcb_randr_get_crtc_gamma_reply(gamma_conn, ramp_cookies[i], nullptr);
+
+		if (sz && sz->size > 0) {
+			const int size = sz->size;
+
+			Crtc c { ids[i], std::vector<uint16_t>(3 * size), {}, {} };
+
+			const auto known = std::find_if(prev.begin(), prev.end(), [&](const Crtc &p) {
+				return p.id == c.id && p.ramp.size() == c.ramp.size();
+			});
+
+			if (known != prev.end()) {
+				c.init = std::move(known->init);
+				c.base = std::move(known->base);
+			} else {
+				if (gamma && xcb_randr_get_crtc_gamma_red_length(gamma) == size) {
+					c.init.resize(c.ramp.size());
+					std::copy_n(xcb_randr_get_crtc_gamma_red(gamma),   size, &c.init[0]);
+					std::copy_n(xcb_randr_get_crtc_gamma_green(gamma), size, &c.init[size]);
+					std::copy_n(xcb_randr_get_crtc_gamma_blue(gamma),  size, &c.init[2 * size]);
+				} else {
+					LOGD << "Failed to get the initial ramp of CRTC " << c.id;
+				}
+
+				if (calibration == CALIBRATION_INITIAL) {
+					if (!c.init.empty() && rampSane(c.init.data(), size))
+						c.base = c.init;
+					else
+						LOGW << "Initial ramp of CRTC " << c.id << " is not a calibration curve. Using a linear one.";
+				} else if (!base_ramp.empty()) {
+					c.base.resize(c.ramp.size());
+					resampleRamp(base_ramp.data(), ramp_sz, c.base.data(), size);
+				}
+			}
+
+			crtcs.push_back(std::move(c));
+		}
+
+		free(gamma);
+		free(sz);
+	}
+
+	free(res);
+
+	LOGV << "RandR CRTCs: " << crtcs.size();
+}
+
+Xcb::~Xcb()
+{
+	destroyRing();
+	xcb_disconnect(gamma_conn);
+	xcb_disconnect(cap_conn);
+}
+
+/**
+ * Rows are padded by the server to scanline_pad bits.
+ */
+int Xcb::bytesPerLine(int width) const
+{
+	return ((width * bits_per_pixel + scanline_pad - 1) / scanline_pad) * (scanline_pad / 8);
+}
+
+/**
+ * The segments are sized for the whole screen once.
+ * They are reused across polls and captured regions.
+ */
+void Xcb::createRing(int width, int height, int count)
+{
+	const size_t sz = size_t(bytesPerLine(width)) * height;
+
+	ring.resize(count);
+
+	for (auto &slot : ring) {
+		slot.shmid = shmget(IPC_PRIVATE, sz, IPC_CREAT | 0600);
+
+		if (slot.shmid == -1) {
+			LOGF << "shmget failed";
+			exit(1);
+		}
+
+		void *shm = shmat(slot.shmid, nullptr, SHM_RDONLY);
+
+		if (shm == reinterpret_cast<void*>(-1)) {
+			LOGF << "shmat failed";
+			exit(1);
+		}
+
+		slot.data = reinterpret_cast<uint8_t*>(shm);
+		slot.seg  = xcb_generate_id(cap_conn);
+
+		// Checked, since everything after this depends on it
+		xcb_generic_error_t *err = xcb_request_check(cap_conn, xcb_shm_attach_checked(cap_conn, slot.seg, slot.shmid, false));
+
+		if (err) {
+			LOGF << "xcb_shm_attach failed with code: " << int(err->error_code);
+			free(err);
+			exit(1);
+		}
+
+		// The segment is removed once both we and the server detach from it
+		shmctl(slot.shmid, IPC_RMID, nullptr);
+	}
+
+	cur    = 0;
+	ring_w = width;
+	ring_h = height;
+
+	LOGV << "Capture ring: " << count << " * " << sz / 1024 << " KiB";
+}
+
+void Xcb::destroyRing()
+{
+	for (auto &slot : ring) {
+		if (slot.pending)
+			xcb_discard_reply(cap_conn, slot.cookie.sequence);
+
+		xcb_shm_detach(cap_conn, slot.seg);
+		shmdt(slot.data);
+	}
+
+	xcb_flush(cap_conn);
+	ring.clear();
+}
+
+/**
+ * Runs on the capture thread, between two captures.
+ * Pending requests were made with the old size, so they're dropped.
+ */
+void Xcb::screenResized()
+{
+	if (scr_w != ring_w || scr_h != ring_h) {
+		const int count = int(ring.size());
+		destroyRing();
+		createRing(scr_w, scr_h, count);
+	} else {
+		LOGV << "Screen size unchanged, reusing capture ring";
+	}
+
+	// Monitors may have been added or removed
+	std::lock_guard lock(gamma_mtx);
+	queryCrtcs();
+}
+
+void Xcb::requestImage(ShmSlot &slot)
+{
+	slot.rect    = captureRect();
+	slot.cookie  = xcb_shm_get_image(cap_conn, root, slot.rect.x, slot.rect.y, slot.rect.w, slot.rect.h, ~0u, XCB_IMAGE_FORMAT_Z_PIXMAP, slot.seg, 0);
+	slot.pending = true;
+	xcb_flush(cap_conn);
+}
+
+/**
+ * Requests are sent unchecked, so errors arrive as events.
+ * They are only logged.
+ */
+void Xcb::drainErrors(xcb_connection_t *conn)
+{
+	while (xcb_generic_event_t *e = xcb_poll_for_event(conn)) {
+		if (e->response_type == 0) {
+			const auto err = reinterpret_cast<xcb_generic_error_t*>(e);
+			LOGD << "XCB error " << int(err->error_code) << " (request: " << int(err->major_code) << ')';
+		}
+		free(e);
+	}
+}
+
+/**
+ * Drops the frame requested on the previous poll, when it no longer
+ * shows the screen (e.g. after a workspace switch).
+ * The next getScreenBrightness() then waits for a fresh one.
+ */
+void Xcb::discardCapture()
+{
+	for (auto &slot : ring) {
+		if (slot.pending) {
+			xcb_discard_reply(cap_conn, slot.cookie.sequence);
+			slot.pending = false;
+		}
+	}
+}
+
+/**
+ * Waits for the oldest pending frame, issues the request for the next one
+ * and only then reduces. With N segments, the returned brightness is the one
+ * of the frame requested N - 1 calls ago, unless it was discarded.
+ */
+int Xcb::getScreenBrightness() noexcept
+{
+	using namespace std::chrono;
+
+	processEvents();
+
+	const size_t n = ring.size();
+
+	// On the first call and after a discard, the ring is filled in order
+	for (size_t i = 0; i < n - 1; ++i) {
+		ShmSlot &s = ring[(cur + i) % n];
+
+		if (!s.pending)
+			requestImage(s);
+	}
+
+	ShmSlot &slot = ring[cur];
+
+	const auto t0 = steady_clock::now();
+
+	xcb_generic_error_t *err = nullptr;
+	const auto reply = xcb_shm_get_image_reply(cap_conn, slot.cookie, &err);
+	slot.pending = false;
+
+	const auto t1 = steady_clock::now();
+
+	// The only free segment other than the one being reduced
+	requestImage(ring[(cur + n - 1) % n]);
+	cur = (cur + 1) % n;
+
+	if (!reply) {
+		LOGD << "shm_get_image failed" << (err ? " with code: " + std::to_string(err->error_code) : "");
+		free(err);
+		return 0;
+	}
+
+	free(reply);
+
+	const Rect &r   = slot.rect;
+	const int   brt = calcImageBrightness(slot.data, r.w, r.h, bytesPerLine(r.w));
+
+	const auto t2 = steady_clock::now();
+
+	LOGV << "Capture wait: " << duration_cast<microseconds>(t1 - t0).count()
+	     << " us, reduce: " << duration_cast<microseconds>(t2 - t1).count() << " us";
+
+	return brt;
+}
+
+void Xcb::setGamma(int brt, int temp)
+{
+	std::lock_guard lock(gamma_mtx);
+
+	// Each CRTC gets a ramp generated at its own size
+	for (auto &c : crtcs) {
+		const int sz = int(c.ramp.size() / 3);
+		uint16_t *r  = c.ramp.data();
+
+		if (c.base.empty())
+			fillGammaRamp(&r[0], &r[sz], &r[2 * sz], sz, brt, temp);
+		else
+			composeGammaRamp(&r[0], &r[sz], &r[2 * sz], c.base.data(), sz, brt, temp);
+		xcb_randr_set_crtc_gamma(gamma_conn, c.id, sz, &r[0], &r[sz], &r[2 * sz]);
+	}
+
+	// No replies to wait for: the requests are just flushed.
+	xcb_flush(gamma_conn);
+
+	drainErrors(gamma_conn);
+}
+
+/**
+ * XF86VidMode only reaches the CRTCs of the default screen's primary output,
+ * so each CRTC is restored on its own.
+ */
+void Xcb::setInitialGamma(bool set_previous)
+{
+	if (!set_previous) {
+		LOGI << "Setting pure gamma";
+		setGamma(brt_steps_max, 0);
+		return;
+	}
+
+	LOGI << "Setting previous gamma";
+
+	std::lock_guard lock(gamma_mtx);
+
+	for (auto &c : crtcs) {
+		const int sz = int(c.ramp.size() / 3);
+		uint16_t *r  = c.ramp.data();
+
+		// Without a ramp to restore, fall back to a linear one
+		if (c.init.empty())
+			fillGammaRamp(&r[0], &r[sz], &r[2 * sz], sz, brt_steps_max, 0);
+		else
+			r = c.init.data();
+
+		xcb_randr_set_crtc_gamma(gamma_conn, c.id, sz, &r[0], &r[sz], &r[2 * sz]);
+	}
+
+	xcb_flush(gamma_conn);
+
+	drainErrors(gamma_conn);
+}
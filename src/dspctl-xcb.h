@@ -0,0 +1,79 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef XCB_H
+#define XCB_H
+
+#include <xcb/xcb.h>
+#include <xcb/shm.h>
+#include <xcb/randr.h>
+#include <mutex>
+#include "dspctl-xlib.h"
+
+/**
+ * Captures and sets the gamma through XCB instead of Xlib.
+ * Capture and gamma each get their own connection, so a pending
+ * shm-get-image never holds up a ramp upload and vice versa.
+ * Captures are double (or triple) buffered: with N segments,
+ * N - 1 requests are kept in flight.
+ * The gamma is set per CRTC through RandR: the requests for all CRTCs
+ * are queued and flushed together, without waiting for replies.
+ * Each CRTC keeps the ramp it had when first seen, to be built on and restored.
+ */
+class Xcb : public Vidmode
+{
+public:
+	Xcb();
+	~Xcb();
+	int  getScreenBrightness() noexcept;
+	void discardCapture();
+	void setGamma(int brt, int temp);
+	void setInitialGamma(bool set_previous);
+protected:
+	void screenResized() override;
+private:
+	xcb_connection_t *cap_conn;
+	xcb_connection_t *gamma_conn;
+	xcb_window_t     root;
+	int              scr_num;
+
+	/* Ring of shm segments. The request for the next frame is issued
+	 * before the previous one is reduced, so the server copies
+	 * the screen while we reduce and sleep. */
+	struct ShmSlot {
+		xcb_shm_seg_t              seg;
+		int                        shmid   = -1;
+		uint8_t                    *data   = nullptr;
+		Rect                       rect    {};
+		xcb_shm_get_image_cookie_t cookie  {};
+		bool                       pending = false;
+	};
+
+	std::vector<ShmSlot> ring;
+	size_t               cur    = 0;
+	int                  ring_w = 0;
+	int                  ring_h = 0;
+
+	struct Crtc {
+		xcb_randr_crtc_t      id;
+		std::vector<uint16_t> ramp;
+		std::vector<uint16_t> init; // Ramp found when the CRTC was first queried
+		std::vector<uint16_t> base; // Calibration at this CRTC's size, empty when linear
+	};
+
+	std::vector<Crtc> crtcs;
+	std::mutex        gamma_mtx;
+
+	void queryCrtcs();
+	void createRing(int width, int height, int count);
+	void destroyRing();
+	void requestImage(ShmSlot &slot);
+	int  bytesPerLine(int width) const;
+	void drainErrors(xcb_connection_t *conn);
+};
+
+typedef Xcb DspCtl;
+
+#endif // XCB_H
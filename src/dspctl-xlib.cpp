@@ -4,13 +4,32 @@
  */
 
 #include <X11/Xutil.h>
+#include <X11/Xatom.h>
 #include <X11/extensions/xf86vmode.h>
 #include <X11/extensions/XShm.h>
+#include <X11/extensions/scrnsaver.h>
+#include <X11/extensions/dpms.h>
+#include <X11/extensions/Xrandr.h>
 #include "dspctl-xlib.h"
 #include "defs.h"
 #include "utils.h"
+#include "cfg.h"
+#include "luma.h"
+#include "sampler.h"
+#include "ramp.h"
+#include "icc.h"
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <poll.h>
+#include <chrono>
+
+static int errorHandler(Display *dsp, XErrorEvent *e)
+{
+	char txt[256];
+	XGetErrorText(dsp, e->error_code, txt, sizeof(txt));
+	LOGD << "X error: " << txt << " (request: " << int(e->request_code) << ')';
+	return 0;
+}
 
 XLib::XLib()
 {
@@ -18,24 +37,361 @@ XLib::XLib()
 		LOGE << "Failed to initialize XThreads. App may crash unexpectedly.";
 	}
 
+	// The tracked windows can be destroyed at any time. Don't let BadWindow kill us.
+	XSetErrorHandler(errorHandler);
+
 	dsp              = XOpenDisplay(nullptr);
 	default_root_wnd = DefaultRootWindow(dsp);
 	default_scr      = DefaultScreenOfDisplay(dsp);
 	default_scr_num  = XDefaultScreen(dsp);
 	scr_count        = XScreenCount(dsp);
+	scr_w            = default_scr->width;
+	scr_h            = default_scr->height;
 	LOGV << "XDisplay initialized. Screens: " << scr_count;
+
+	int n;
+	XPixmapFormatValues *formats = XListPixmapFormats(dsp, &n);
+
+	for (int i = 0; i < n; ++i) {
+		if (formats[i].depth == default_scr->root_depth) {
+			bits_per_pixel = formats[i].bits_per_pixel;
+			scanline_pad   = formats[i].scanline_pad;
+		}
+	}
+
+	XFree(formats);
+
+	// Pick the sampling kernels once, instead of checking the format per pixel
+	const Visual *vis = DefaultVisualOfScreen(default_scr);
+	pixfmt = pixelFormat(bits_per_pixel, vis->red_mask, vis->green_mask, vis->blue_mask, ImageByteOrder(dsp) == MSBFirst);
+
+	LOGD << "Pixel format: " << pixfmt.name << ", depth: " << default_scr->root_depth << ", bpp: " << bits_per_pixel;
+
+	if (bits_per_pixel < 16 || bits_per_pixel % 8 != 0) {
+		LOGW << "Unsupported pixel size: " << bits_per_pixel << " bits. Brightness detection may be inaccurate.";
+	}
+
+	evt_dsp        = XOpenDisplay(nullptr);
+	net_active_wnd = XInternAtom(evt_dsp, "_NET_ACTIVE_WINDOW", False);
+	net_wm_state   = XInternAtom(evt_dsp, "_NET_WM_STATE", False);
+	net_fullscreen = XInternAtom(evt_dsp, "_NET_WM_STATE_FULLSCREEN", False);
+	net_current_desktop = XInternAtom(evt_dsp, "_NET_CURRENT_DESKTOP", False);
+
+	// SubstructureNotify: top level windows being mapped
+	XSelectInput(evt_dsp, DefaultRootWindow(evt_dsp), PropertyChangeMask | SubstructureNotifyMask);
+	updateActiveWindow();
+
+	int err_base;
+
+	if (XRRQueryExtension(evt_dsp, &rr_event_base, &err_base)) {
+		XRRSelectInput(evt_dsp, DefaultRootWindow(evt_dsp), RRScreenChangeNotifyMask);
+	} else {
+		rr_event_base = -1;
+		LOGD << "RandR unavailable. Screen size changes won't be detected.";
+	}
+
+	if (XScreenSaverQueryExtension(evt_dsp, &ss_event_base, &err_base)) {
+		XScreenSaverSelectInput(evt_dsp, DefaultRootWindow(evt_dsp), ScreenSaverNotifyMask);
+
+		XScreenSaverInfo *info = XScreenSaverAllocInfo();
+		if (XScreenSaverQueryInfo(evt_dsp, DefaultRootWindow(evt_dsp), info))
+			ss_on = info->state == ScreenSaverOn;
+		XFree(info);
+	} else {
+		ss_event_base = -1;
+		LOGD << "MIT-SCREEN-SAVER unavailable";
+	}
+
+	int dpms_ev_base;
+	dpms_available = DPMSQueryExtension(evt_dsp, &dpms_ev_base, &err_base) && DPMSCapable(evt_dsp);
+	LOGD_IF(!dpms_available) << "DPMS unavailable";
 }
 
 XLib::~XLib()
 {
+	if (evt_dsp)
+		XCloseDisplay(evt_dsp);
+
 	if (dsp)
 		XCloseDisplay(dsp);
 }
 
+/**
+ * Handles the queued events without blocking.
+ * The active window and its geometry are cached here,
+ * so they never need to be queried on each poll.
+ */
+void XLib::processEvents()
+{
+	while (XPending(evt_dsp)) {
+		XEvent e;
+		XNextEvent(evt_dsp, &e);
+
+		if (rr_event_base != -1 && e.type == rr_event_base + RRScreenChangeNotify) {
+			XRRUpdateConfiguration(&e);
+
+			const int w = DisplayWidth(evt_dsp, DefaultScreen(evt_dsp));
+			const int h = DisplayHeight(evt_dsp, DefaultScreen(evt_dsp));
+
+			if (w != scr_w || h != scr_h) {
+				LOGI << "Screen resized: " << w << '*' << h;
+				scr_w = w;
+				scr_h = h;
+				screenResized();
+			}
+			continue;
+		}
+
+		if (ss_event_base != -1 && e.type == ss_event_base + ScreenSaverNotify) {
+			ss_on = reinterpret_cast<XScreenSaverNotifyEvent*>(&e)->state == ScreenSaverOn;
+			LOGD << "Screensaver " << (ss_on ? "on" : "off");
+			continue;
+		}
+
+		switch (e.type) {
+		case PropertyNotify:
+			if (e.xproperty.atom == net_active_wnd) {
+				const Window prev = active_wnd;
+				updateActiveWindow();
+				scene_changed |= active_wnd != prev;
+			} else if (e.xproperty.atom == net_current_desktop) {
+				scene_changed = true;
+			} else if (e.xproperty.window == active_wnd && e.xproperty.atom == net_wm_state) {
+				updateFullscreen();
+			}
+			break;
+		case MapNotify:
+			if (isLargeWindow(e.xmap))
+				scene_changed = true;
+			break;
+		case ConfigureNotify:
+			if (e.xconfigure.window == active_wnd)
+				updateActiveGeometry();
+			break;
+		case DestroyNotify:
+			if (e.xdestroywindow.window == active_wnd) {
+				active_wnd        = 0;
+				active_rect       = {};
+				active_fullscreen = false;
+			}
+			break;
+		}
+	}
+}
+
+/**
+ * Sleeps for up to timeout_ms on the event connection. Returns true,
+ * early, when the scene has changed: focus moved to another window,
+ * the workspace was switched or a large window was mapped.
+ */
+bool XLib::waitForEvent(int timeout_ms)
+{
+	using namespace std::chrono;
+
+	const auto deadline = steady_clock::now() + milliseconds(timeout_ms);
+
+	processEvents();
+
+	while (!scene_changed) {
+		const auto remaining = duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+
+		if (remaining <= 0)
+			break;
+
+		// The queue was drained by processEvents(), so only the socket needs checking
+		pollfd p { ConnectionNumber(evt_dsp), POLLIN, 0 };
+
+		if (poll(&p, 1, int(remaining)) > 0)
+			processEvents();
+	}
+
+	const bool changed = scene_changed;
+	scene_changed = false;
+
+	LOGV_IF(changed) << "Scene changed";
+
+	return changed;
+}
+
+/**
+ * Menus and tooltips are override-redirect, and too small anyway.
+ * A quarter of the screen is enough to move the brightness.
+ */
+bool XLib::isLargeWindow(const XMapEvent &e) const
+{
+	if (e.event != DefaultRootWindow(evt_dsp) || e.override_redirect)
+		return false;
+
+	XWindowAttributes attr;
+
+	if (!XGetWindowAttributes(evt_dsp, e.window, &attr))
+		return false;
+
+	return int64_t(attr.width) * attr.height * 4 >= int64_t(scr_w) * scr_h;
+}
+
+bool XLib::captureSupported() const
+{
+	return true;
+}
+
+/**
+ * Xshm captures synchronously, so there's no older frame to drop.
+ */
+void XLib::discardCapture()
+{
+}
+
+/**
+ * Returns false while the screensaver is running or DPMS has turned off the monitor.
+ * The screensaver state comes from events, DPMS has to be queried.
+ */
+bool XLib::screenActive()
+{
+	processEvents();
+
+	if (ss_on)
+		return false;
+
+	if (dpms_available) {
+		CARD16 level;
+		BOOL   enabled;
+
+		if (DPMSInfo(evt_dsp, &level, &enabled) && enabled && level != DPMSModeOn)
+			return false;
+	}
+
+	return true;
+}
+
+void XLib::updateActiveWindow()
+{
+	Atom          type;
+	int           format;
+	unsigned long n, remaining;
+	unsigned char *data = nullptr;
+
+	const int status = XGetWindowProperty(evt_dsp, DefaultRootWindow(evt_dsp), net_active_wnd, 0, 1, False, XA_WINDOW,
+	                                      &type, &format, &n, &remaining, &data);
+
+	Window wnd = 0;
+
+	if (status == Success && data && n > 0)
+		wnd = *reinterpret_cast<Window*>(data);
+
+	if (data)
+		XFree(data);
+
+	if (wnd == active_wnd)
+		return;
+
+	if (active_wnd)
+		XSelectInput(evt_dsp, active_wnd, NoEventMask);
+
+	active_wnd = wnd;
+
+	if (active_wnd)
+		XSelectInput(evt_dsp, active_wnd, StructureNotifyMask | PropertyChangeMask);
+
+	updateActiveGeometry();
+	updateFullscreen();
+}
+
+void XLib::updateActiveGeometry()
+{
+	XWindowAttributes attr;
+	Window child;
+	int x, y;
+
+	if (!active_wnd
+	    || !XGetWindowAttributes(evt_dsp, active_wnd, &attr)
+	    || !XTranslateCoordinates(evt_dsp, active_wnd, DefaultRootWindow(evt_dsp), 0, 0, &x, &y, &child)) {
+		active_rect = {};
+		return;
+	}
+
+	active_rect = { x, y, attr.width, attr.height };
+	LOGV << "Active window: " << active_rect.w << '*' << active_rect.h << " at " << x << ',' << y;
+}
+
+void XLib::updateFullscreen()
+{
+	active_fullscreen = false;
+
+	if (!active_wnd)
+		return;
+
+	Atom          type;
+	int           format;
+	unsigned long n, remaining;
+	unsigned char *data = nullptr;
+
+	const int status = XGetWindowProperty(evt_dsp, active_wnd, net_wm_state, 0, 64, False, XA_ATOM,
+	                                      &type, &format, &n, &remaining, &data);
+
+	if (status == Success && data) {
+		const Atom *states = reinterpret_cast<Atom*>(data);
+		active_fullscreen  = std::find(states, states + n, net_fullscreen) != states + n;
+	}
+
+	if (data)
+		XFree(data);
+
+	LOGV << "Active window fullscreen: " << active_fullscreen;
+}
+
+/**
+ * Cached, updated by processEvents().
+ */
+bool XLib::fullscreenActive() const
+{
+	return active_fullscreen;
+}
+
+/**
+ * Returns the part of the root window to be captured.
+ * Falls back to the whole screen if there is no usable active window.
+ */
+XLib::Rect XLib::captureRect() const
+{
+	const Rect full { 0, 0, scr_w, scr_h };
+
+	if (cfg["brt_region"].get<int>() != REGION_ACTIVE_WINDOW)
+		return full;
+
+	const int x0 = std::max(active_rect.x, 0);
+	const int y0 = std::max(active_rect.y, 0);
+	const int x1 = std::min(active_rect.x + active_rect.w, full.w);
+	const int y1 = std::min(active_rect.y + active_rect.h, full.h);
+
+	if (x1 - x0 <= 0 || y1 - y0 <= 0)
+		return full;
+
+	return { x0, y0, x1 - x0, y1 - y0 };
+}
+
+int XLib::calcImageBrightness(const uint8_t *buf, int width, int height, int bytes_per_line) const
+{
+	LumaHistogram h;
+	sampleImage(h, buf, width, height, bytes_per_line, 0, height);
+	return brightnessMetric(h);
+}
+
+/**
+ * Adds the samples of an image, or of a strip of it, to the histogram.
+ */
+void XLib::sampleImage(LumaHistogram &h, const uint8_t *buf, int width, int height, int bytes_per_line, int y_offset, int full_height) const
+{
+	samplePixels(pixfmt, h, buf, width, height, bytes_per_line, y_offset, full_height);
+}
+
 int XLib::getScreenBrightness() noexcept
 {
-	const auto img = XGetImage(dsp, default_root_wnd, 0, 0, default_scr->width, default_scr->height, AllPlanes, ZPixmap);
-	int brt = calcBrightness(reinterpret_cast<uint8_t*>(img->data), img->bytes_per_line * img->height, img->bits_per_pixel / 8, 1024);
+	processEvents();
+	const Rect r = captureRect();
+
+	const auto img = XGetImage(dsp, default_root_wnd, r.x, r.y, r.w, r.h, AllPlanes, ZPixmap);
+	const int  brt = calcImageBrightness(reinterpret_cast<uint8_t*>(img->data), img->width, img->height, img->bytes_per_line);
 	img->f.destroy_image(img);
 	return brt;
 }
@@ -72,6 +428,44 @@ Vidmode::Vidmode()
 		LOGE << "Failed to get initial gamma ramp";
 		initial_ramp_exists = false;
 	}
+
+	loadCalibration();
+}
+
+void Vidmode::loadCalibration()
+{
+	base_ramp.clear();
+
+	switch (cfg["gamma_calibration"].get<int>()) {
+	case CALIBRATION_INITIAL:
+		if (!initial_ramp_exists)
+			break;
+
+		if (!rampSane(init_ramp.data(), ramp_sz)) {
+			LOGW << "Initial gamma ramp is not a calibration curve. Using a linear one.";
+			break;
+		}
+
+		base_ramp.assign(init_ramp.begin(), init_ramp.begin() + 3 * ramp_sz);
+		LOGI << "Applying gamma on top of the initial ramp";
+		break;
+	case CALIBRATION_ICC: {
+		std::vector<uint16_t> vcgt;
+
+		if (!loadVcgt(cfg["gamma_icc_path"], ramp_sz, vcgt))
+			break;
+
+		if (!rampSane(vcgt.data(), ramp_sz)) {
+			LOGW << "VCGT is not a valid calibration curve. Using a linear one.";
+			break;
+		}
+
+		base_ramp = std::move(vcgt);
+		break;
+	}
+	default:
+		break;
+	}
 }
 
 Vidmode::~Vidmode()
@@ -81,29 +475,14 @@ Vidmode::~Vidmode()
 
 void Vidmode::fillRamp(const int brt_step, const int temp_step)
 {
-	/**
-	 * The ramp multiplier equals 32 when ramp_sz = 2048, 64 when 1024, etc.
-	 * Assuming ramp_sz = 2048 and pure state (default brightness/temp)
-	 * the RGB channels look like:
-	 * [ 0, 32, 64, 96, ... UINT16_MAX - 32 ]
-	 */
 	uint16_t *r = &ramp[0 * ramp_sz];
 	uint16_t *g = &ramp[1 * ramp_sz];
 	uint16_t *b = &ramp[2 * ramp_sz];
 
-	const double r_mult = interpTemp(temp_step, 0),
-	             g_mult = interpTemp(temp_step, 1),
-	             b_mult = interpTemp(temp_step, 2);
-
-	const int    ramp_mult = (UINT16_MAX + 1) / ramp_sz;
-	const double brt_mult  = normalize(brt_step, 0, brt_steps_max) * ramp_mult;
-
-	for (int i = 0; i < ramp_sz; ++i) {
-		const int val = std::clamp(int(i * brt_mult), 0, UINT16_MAX);
-		r[i] = uint16_t(val * r_mult);
-		g[i] = uint16_t(val * g_mult);
-		b[i] = uint16_t(val * b_mult);
-	}
+	if (base_ramp.empty())
+		fillGammaRamp(r, g, b, ramp_sz, brt_step, temp_step);
+	else
+		composeGammaRamp(r, g, b, base_ramp.data(), ramp_sz, brt_step, temp_step);
 }
 
 void Vidmode::setGamma(int scr_br, int temp)
@@ -144,23 +523,18 @@ Xshm::Xshm()
 	LOGV << "Pixmap support: " << (pixmaps == 2);
 
 	default_vis = XDefaultVisual(dsp, 0);
-	shi = createImage();
 
-	if (!shi) {
-		LOGE << "Shared image unavailable";
-	}
+	ensureImage();
 }
 
 Xshm::~Xshm()
 {
-	XDestroyImage(shi);
-	shmdt(shminfo.shmaddr);
-	shmctl(shminfo.shmid, IPC_RMID, nullptr);
+	destroyImage();
 }
 
-XImage* Xshm::createImage()
+XImage* Xshm::createImage(int width, int height)
 {
-	XImage *img = XShmCreateImage(dsp, default_vis, default_scr->root_depth, ZPixmap, nullptr, &shminfo, default_scr->width, default_scr->height);
+	XImage *img = XShmCreateImage(dsp, default_vis, default_scr->root_depth, ZPixmap, nullptr, &shminfo, width, height);
 
 	if (!img) {
 		LOGF << "XShmCreateImage failed";
@@ -190,12 +564,108 @@ XImage* Xshm::createImage()
 		exit(1);
 	}
 
+	img_w = width;
+	img_h = height;
+
 	return img;
 }
 
-int Xshm::getScreenBrightness() noexcept
+void Xshm::destroyImage()
+{
+	if (!shi)
+		return;
+
+	XShmDetach(dsp, &shminfo);
+	XDestroyImage(shi);
+	shmdt(shminfo.shmaddr);
+	shmctl(shminfo.shmid, IPC_RMID, nullptr);
+	shi = nullptr;
+}
+
+/**
+ * (Re)allocates the shared image if its required size has changed.
+ * With a memory budget ("brt_capture_budget", in KiB) the image is a strip
+ * as wide as the screen and as tall as the budget allows, instead of
+ * a full framebuffer.
+ */
+void Xshm::ensureImage()
 {
-	XShmGetImage(dsp, default_root_wnd, shi, 0, 0, AllPlanes);
-	return calcBrightness(reinterpret_cast<uint8_t*>(shi->data), shi->bytes_per_line * shi->height, shi->bits_per_pixel / 8, 1024);
+	int w = scr_w;
+	int h = scr_h;
+
+	const int64_t budget = cfg["brt_capture_budget"].get<int64_t>() * 1024;
+
+	if (budget > 0) {
+		const int64_t bpl = ((int64_t(w) * bits_per_pixel + scanline_pad - 1) / scanline_pad) * (scanline_pad / 8);
+		h = int(std::clamp<int64_t>(budget / bpl, 1, scr_h));
+	}
+
+	if (shi && w == img_w && h == img_h)
+		return;
+
+	destroyImage();
+	shi = createImage(w, h);
+
+	LOGD << "Shared image: " << w << '*' << h << " (" << shi->bytes_per_line * h / 1024 << " KiB)";
 }
 
+/**
+ * Runs on the capture thread, between two captures.
+ * The gamma threads don't touch the image, so they keep running.
+ */
+void Xshm::screenResized()
+{
+	ensureImage();
+}
+
+/**
+ * XShmGetImage uses the image size as the size of the request.
+ * Shrinking it to the captured rectangle reduces the bytes transferred,
+ * the segment itself keeps its size.
+ */
+void Xshm::capture(int x, int y, int w, int h)
+{
+	shi->width          = w;
+	shi->height         = h;
+	shi->bytes_per_line = ((w * shi->bits_per_pixel + shi->bitmap_pad - 1) / shi->bitmap_pad) * (shi->bitmap_pad / 8);
+
+	XShmGetImage(dsp, default_root_wnd, shi, x, y, AllPlanes);
+}
+
+int Xshm::getScreenBrightness() noexcept
+{
+	processEvents();
+	ensureImage();
+
+	const Rect r   = captureRect();
+	const auto buf = reinterpret_cast<uint8_t*>(shi->data);
+
+	LumaHistogram h;
+
+	if (r.h <= img_h) {
+		capture(r.x, r.y, r.w, r.h);
+		sampleImage(h, buf, r.w, r.h, shi->bytes_per_line, 0, r.h);
+		return brightnessMetric(h);
+	}
+
+	/* The region doesn't fit in the budget: capture it in strips,
+	 * reducing each one into the same histogram. With "brt_capture_strips",
+	 * only that many evenly spaced strips are read per poll. Their phase
+	 * rotates on each poll, so the whole region is covered over time. */
+	const int strips     = (r.h + img_h - 1) / img_h;
+	const int max_strips = cfg["brt_capture_strips"];
+	const int count      = max_strips > 0 ? std::min(strips, max_strips) : strips;
+
+	for (int i = 0; i < count; ++i) {
+		const int idx = count == strips ? i : (i * strips / count + strip_phase) % strips;
+		const int y   = idx * img_h;
+		const int sh  = std::min(img_h, r.h - y);
+
+		capture(r.x, r.y + y, r.w, sh);
+		sampleImage(h, buf, r.w, sh, shi->bytes_per_line, y, r.h);
+	}
+
+	strip_phase = (strip_phase + 1) % strips;
+
+	return brightnessMetric(h);
+}
@@ -10,6 +10,9 @@
 #include <X11/extensions/XShm.h>
 #include <cstdint>
 #include <vector>
+#include "pixfmt.h"
+
+struct LumaHistogram;
 
 class XLib
 {
@@ -17,12 +20,63 @@ public:
 	XLib();
 	~XLib();
 	int getScreenBrightness() noexcept;
+	bool captureSupported() const;
+	void discardCapture();
+	bool screenActive();
+	bool fullscreenActive() const;
+	bool waitForEvent(int timeout_ms);
 protected:
+	struct Rect {
+		int x, y, w, h;
+	};
+
 	Display *dsp;
 	int scr_count;
 	Window  default_root_wnd;
 	Screen  *default_scr;
 	int     default_scr_num;
+
+	// Kept up to date on RandR screen changes
+	int scr_w;
+	int scr_h;
+
+	// Layout of root window images, from the default visual
+	int         bits_per_pixel = 32;
+	int         scanline_pad   = 32;
+	PixelFormat pixfmt;
+
+	/* Called from processEvents() after the screen size changed,
+	 * so capture buffers can be reallocated on the capture thread. */
+	virtual void screenResized() {}
+
+	void processEvents();
+	Rect captureRect() const;
+	int  calcImageBrightness(const uint8_t *buf, int width, int height, int bytes_per_line) const;
+	void sampleImage(LumaHistogram &h, const uint8_t *buf, int width, int height, int bytes_per_line, int y_offset, int full_height) const;
+private:
+	/* Separate connection for window tracking, only used by the capture thread,
+	 * so that handling events never contends with gamma updates on 'dsp'. */
+	Display *evt_dsp;
+	Atom    net_active_wnd;
+	Atom    net_wm_state;
+	Atom    net_fullscreen;
+	Atom    net_current_desktop;
+	Window  active_wnd = 0;
+	Rect    active_rect {};
+	bool    active_fullscreen = false;
+
+	// Set by processEvents() when what's on screen has likely changed
+	bool    scene_changed = false;
+
+	int  rr_event_base  = -1;
+	int  ss_event_base  = -1;
+	bool ss_on          = false;
+	bool dpms_available = false;
+
+	void updateActiveWindow();
+	void updateActiveGeometry();
+	void updateFullscreen();
+	bool isLargeWindow(const XMapEvent &e) const;
 };
 
 class Vidmode : public XLib
@@ -32,12 +86,19 @@ public:
 	~Vidmode();
 	void setGamma(int, int);
 	void setInitialGamma(bool);
-private:
+protected:
 	int ramp_sz;
-	bool initial_ramp_exists = true;
 	std::vector<uint16_t> ramp;
-	std::vector<uint16_t> init_ramp;
+
+	/* Calibration curve the ramps are built on, of 3 * ramp_sz entries.
+	 * Empty when linear. Picked once, so each step is just a scale. */
+	std::vector<uint16_t> base_ramp;
+
 	void fillRamp(const int brightness, const int temp);
+private:
+	bool initial_ramp_exists = true;
+	std::vector<uint16_t> init_ramp;
+	void loadCalibration();
 };
 
 class Xshm : public Vidmode
@@ -46,13 +107,23 @@ public:
 	Xshm();
 	~Xshm();
 	int getScreenBrightness() noexcept;
+protected:
+	void screenResized() override;
 private:
 	XShmSegmentInfo shminfo;
-	XImage *shi;
+	XImage *shi = nullptr;
 	Visual *default_vis;
-	XImage* createImage();
+	int    img_w = 0;
+	int    img_h = 0;
+	int    strip_phase = 0;
+	XImage* createImage(int width, int height);
+	void    destroyImage();
+	void    ensureImage();
+	void    capture(int x, int y, int w, int h);
 };
 
+#ifndef GAMMY_XCB
 typedef Xshm DspCtl;
+#endif
 
 #endif // X11_H
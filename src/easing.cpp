@@ -0,0 +1,47 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "easing.h"
+
+// easeOutExpo stops 2^-10 short of the end, then jumps there
+static constexpr double expo_end = 1 - 1. / 1024;
+
+double ease(int easing, double x)
+{
+	x = std::clamp(x, 0., 1.);
+
+	switch (easing) {
+	case EASE_STEP:
+		return x < 1 ? 0 : 1;
+	case EASE_IN_OUT_QUAD:
+		return x < 0.5 ? 2 * x * x : 1 - 2 * (1 - x) * (1 - x);
+	case EASE_OUT_EXPO:
+		return x < 1 ? 1 - std::pow(2, -10 * x) : 1;
+	default:
+		return x;
+	}
+}
+
+double easeInverse(int easing, double y)
+{
+	if (y <= 0)
+		return 0;
+
+	if (y >= 1)
+		return 1;
+
+	switch (easing) {
+	case EASE_STEP:
+		return 1;
+	case EASE_IN_OUT_QUAD:
+		return y < 0.5 ? std::sqrt(y / 2) : 1 - std::sqrt((1 - y) / 2);
+	case EASE_OUT_EXPO:
+		return y < expo_end ? -std::log2(1 - y) / 10 : 1;
+	default:
+		return y;
+	}
+}
@@ -0,0 +1,32 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef EASING_H
+#define EASING_H
+
+/**
+ * How a value moves from one point to the next.
+ * Stored in the config as the "easing" of a keyframe.
+ */
+enum Easing {
+	EASE_LINEAR,
+	EASE_STEP,        // Hold the previous value, then jump
+	EASE_IN_OUT_QUAD,
+	EASE_OUT_EXPO,
+	EASE_COUNT
+};
+
+/**
+ * Progress in [0, 1] at time x in [0, 1].
+ */
+double ease(int easing, double x);
+
+/**
+ * Earliest time in [0, 1] at which the progress reaches y.
+ * All the easings are monotonic, so this is exact.
+ */
+double easeInverse(int easing, double y);
+
+#endif // EASING_H
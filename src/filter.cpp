@@ -0,0 +1,118 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "filter.h"
+#include "cfg.h"
+
+EmaFilter::EmaFilter(double tau) : tau(tau)
+{
+
+}
+
+double EmaFilter::update(double x, double dt)
+{
+	if (first || tau <= 0) {
+		first = false;
+		return y = x;
+	}
+
+	const double a = 1 - std::exp(-dt / tau);
+	return y += a * (x - y);
+}
+
+void EmaFilter::reset()
+{
+	first = true;
+}
+
+// One euro --------------------------------------------------------------
+
+static double smoothingFactor(double dt, double cutoff)
+{
+	constexpr double pi = 3.14159265358979323846;
+	const double r = 2 * pi * cutoff * dt;
+	return r / (r + 1);
+}
+
+OneEuroFilter::OneEuroFilter(double min_cutoff, double beta, double d_cutoff)
+    : min_cutoff(min_cutoff), beta(beta), d_cutoff(d_cutoff)
+{
+
+}
+
+double OneEuroFilter::update(double x, double dt)
+{
+	if (first || dt <= 0) {
+		first = false;
+		dx_prev = 0;
+		return x_prev = x;
+	}
+
+	const double dx     = (x - x_prev) / dt;
+	const double a_d    = smoothingFactor(dt, d_cutoff);
+	dx_prev             = a_d * dx + (1 - a_d) * dx_prev;
+
+	const double cutoff = min_cutoff + beta * std::abs(dx_prev);
+	const double a      = smoothingFactor(dt, cutoff);
+
+	return x_prev = a * x + (1 - a) * x_prev;
+}
+
+void OneEuroFilter::reset()
+{
+	first = true;
+}
+
+// Median ----------------------------------------------------------------
+
+MedianFilter::MedianFilter(size_t n) : n(std::max(n, size_t(1)))
+{
+
+}
+
+double MedianFilter::update(double x, [[maybe_unused]] double dt)
+{
+	window.push_back(x);
+
+	if (window.size() > n)
+		window.pop_front();
+
+	std::vector<double> tmp(window.begin(), window.end());
+	const auto mid = tmp.begin() + tmp.size() / 2;
+	std::nth_element(tmp.begin(), mid, tmp.end());
+
+	return *mid;
+}
+
+void MedianFilter::reset()
+{
+	window.clear();
+}
+
+std::unique_ptr<LumaFilter> createFilter(int type)
+{
+	switch (type) {
+	case FILTER_ONE_EURO:
+		return std::make_unique<OneEuroFilter>(cfg["brt_filter_cutoff"].get<double>(), cfg["brt_filter_beta"].get<double>());
+	case FILTER_MEDIAN:
+		return std::make_unique<MedianFilter>(std::clamp(cfg["brt_filter_window"].get<int>(), 1, median_window_max));
+	default:
+		return std::make_unique<EmaFilter>(cfg["brt_filter_tau"].get<double>());
+	}
+}
+
+json filterSettings()
+{
+	return {
+		cfg["brt_filter"],
+		cfg["brt_filter_tau"],
+		cfg["brt_filter_cutoff"],
+		cfg["brt_filter_beta"],
+		cfg["brt_filter_window"],
+	};
+}
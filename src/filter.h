@@ -0,0 +1,94 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <deque>
+#include <memory>
+#include "cfg.h"
+
+/**
+ * Filters applied to the screen brightness samples before they are
+ * turned into brightness targets. Stored in the config as "brt_filter".
+ */
+enum FilterType {
+	FILTER_EMA,
+	FILTER_ONE_EURO,
+	FILTER_MEDIAN,
+	FILTER_COUNT
+};
+
+class LumaFilter
+{
+public:
+	virtual ~LumaFilter() = default;
+
+	/* Feeds a sample taken dt seconds after the previous one.
+	 * Returns the filtered value. */
+	virtual double update(double x, double dt) = 0;
+	virtual void   reset() = 0;
+};
+
+/**
+ * Exponential moving average with time constant tau (in seconds),
+ * so that the amount of smoothing doesn't depend on the polling rate.
+ */
+class EmaFilter : public LumaFilter
+{
+public:
+	EmaFilter(double tau);
+	double update(double x, double dt) override;
+	void   reset() override;
+private:
+	double tau;
+	double y     = 0;
+	bool   first = true;
+};
+
+/**
+ * One euro filter (Casiez et al. 2012). Smooths heavily while the signal is
+ * steady and lets large, fast changes through with little lag.
+ */
+class OneEuroFilter : public LumaFilter
+{
+public:
+	OneEuroFilter(double min_cutoff, double beta, double d_cutoff = 1.);
+	double update(double x, double dt) override;
+	void   reset() override;
+private:
+	double min_cutoff;
+	double beta;
+	double d_cutoff;
+	double x_prev  = 0;
+	double dx_prev = 0;
+	bool   first   = true;
+};
+
+// Upper bound of "brt_filter_window"
+constexpr int median_window_max = 64;
+
+/**
+ * Median of the last n samples. Ignores short spikes entirely.
+ */
+class MedianFilter : public LumaFilter
+{
+public:
+	MedianFilter(size_t n);
+	double update(double x, double dt) override;
+	void   reset() override;
+private:
+	size_t n;
+	std::deque<double> window;
+};
+
+std::unique_ptr<LumaFilter> createFilter(int type);
+
+/**
+ * The settings createFilter() reads. The filter is recreated when they change.
+ */
+json filterSettings();
+
+#endif // FILTER_H
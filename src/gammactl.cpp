@@ -3,16 +3,31 @@
  * License: https://github.com/Fushko/gammy#license
  */
 
-#include <QTime>
 #include <thread>
+#include <cmath>
 #include "gammactl.h"
 #include "defs.h"
 #include "utils.h"
 #include "cfg.h"
 #include "mediator.h"
+#include "filter.h"
+#include "solar.h"
+#include "transition.h"
 
 GammaCtl::GammaCtl()
 {
+#ifndef _WIN32
+	backlight.onWritten([this] {
+		force_reapply = true;
+		reapply_cv.notify_one();
+	});
+#endif
+
+	if (!captureSupported()) {
+		LOGW << "Screen capture is not supported by this backend. Auto brightness is unavailable.";
+		cfg["brt_auto"] = false;
+	}
+
 	// If auto brightness is on, start at max brightness
 	if (cfg["brt_auto"].get<bool>())
 		cfg["brt_step"] = brt_steps_max;
@@ -24,6 +39,30 @@ GammaCtl::GammaCtl()
 	setGamma(cfg["brt_step"].get<int>(), cfg["temp_step"].get<int>());
 }
 
+/**
+ * With a backlight, it gets the coarse part of the brightness
+ * and the gamma ramp only the residual. Once the backlight write lands,
+ * the ramp is reapplied against the new level.
+ */
+void GammaCtl::setGamma(int brt, int temp)
+{
+#ifndef _WIN32
+	if (backlight.available())
+		brt = int(std::lround(backlight.apply(normalize(brt, 0, brt_steps_max)) * brt_steps_max));
+#endif
+
+	DspCtl::setGamma(brt, temp);
+}
+
+void GammaCtl::setInitialGamma(bool set_previous)
+{
+#ifndef _WIN32
+	backlight.restore();
+#endif
+
+	DspCtl::setInitialGamma(set_previous);
+}
+
 void GammaCtl::start()
 {
 	LOGD << "Starting gamma control";
@@ -32,7 +71,11 @@ void GammaCtl::start()
 		return;
 
 	threads.emplace_back(std::thread([this] { adjustTemperature(); }));
-	threads.emplace_back(std::thread([this] { captureScreen(); }));
+
+	// Auto brightness would just sample zeroes
+	if (captureSupported())
+		threads.emplace_back(std::thread([this] { captureScreen(); }));
+
 	threads.emplace_back(std::thread([this] { reapplyGamma(); }));
 }
 
@@ -63,6 +106,21 @@ void GammaCtl::notify_ss()
 	ss_cv.notify_one();
 }
 
+void GammaCtl::notify_lock(bool locked)
+{
+	setActivity(this->locked, locked);
+}
+
+void GammaCtl::notify_sleep(bool sleeping)
+{
+	setActivity(asleep, sleeping);
+}
+
+void GammaCtl::notify_inhibit(bool inhibited)
+{
+	idle_inhibited = inhibited;
+}
+
 void GammaCtl::notify_all_threads()
 {
 	temp_cv.notify_one();
@@ -70,6 +128,39 @@ void GammaCtl::notify_all_threads()
 	reapply_cv.notify_one();
 }
 
+/**
+ * Updates one of the inactivity conditions.
+ * When all of them clear, the threads are woken up to re-sample the screen,
+ * catch up with the temperature and reapply the gamma.
+ */
+void GammaCtl::setActivity(bool &flag, bool val)
+{
+	using namespace std::chrono;
+
+	std::lock_guard lock(activity_mtx);
+
+	flag = val;
+
+	const bool now_inactive = screen_off || locked || asleep;
+
+	if (now_inactive == inactive)
+		return;
+
+	inactive = now_inactive;
+
+	if (inactive) {
+		LOGI << "Display inactive (screen off: " << screen_off << ", locked: " << locked << ", asleep: " << asleep << "). Suspending.";
+		inactive_since = steady_clock::now();
+		return;
+	}
+
+	LOGI << "Display active after " << duration_cast<seconds>(steady_clock::now() - inactive_since).count() << " s. Resuming.";
+
+	force_temp_change = true;
+	force_reapply     = true;
+	notify_all_threads();
+}
+
 void GammaCtl::reapplyGamma()
 {
 	using namespace std::this_thread;
@@ -82,64 +173,165 @@ void GammaCtl::reapplyGamma()
 		{
 			std::unique_lock<std::mutex> lock(mtx);
 			reapply_cv.wait_until(lock, system_clock::now() + 5s, [&] {
-				return quit;
+				return quit || force_reapply;
 			});
 		}
 
 		if (quit)
 			break;
 
+		force_reapply = false;
+
+		if (inactive)
+			continue;
+
 		setGamma(cfg["brt_step"], cfg["temp_step"]);
 	}
 }
 
 void GammaCtl::captureScreen()
 {
+	using namespace std::chrono;
+	using namespace std::chrono_literals;
+
 	LOGV << "captureScreen() start";
 
 	convar      brt_cv;
 	std::thread brt_thr([&] { adjustBrightness(brt_cv); });
 	std::mutex  m;
 
-	int img_delta = 0;
-	bool force    = false;
+	std::unique_ptr<LumaFilter> filter;
+	std::unique_ptr<LumaFilter> media_filter;
+
+	json filter_settings;
+	int  target_br   = 0; // Filtered brightness that produced the last target
+	bool force         = false;
+	bool media_mode    = false;
+	bool scene_changed = false;
 
 	int
-	prev_img_br = 0,
-	prev_min    = 0,
-	prev_max    = 0,
-	prev_offset = 0;
+	prev_min     = 0,
+	prev_max     = 0,
+	prev_offset  = 0,
+	prev_ambient = brt_steps_max;
 
 	while (true) {
 		{
 			std::unique_lock<std::mutex> lock(m);
 
-			ss_cv.wait(lock, [&] {
-				return cfg["brt_auto"].get<bool>() || quit;
+			// Wake up periodically to keep track of the screen state
+			ss_cv.wait_for(lock, 1s, [&] {
+				return (cfg["brt_auto"].get<bool>() && !inactive) || quit;
 			});
 		}
 
 		if (quit)
 			break;
 
-		if (cfg["brt_auto"].get<bool>())
+		setActivity(screen_off, !screenActive());
+
+		// Resuming always forces a new sample
+		if (cfg["brt_auto"].get<bool>() && !inactive)
 			force = true;
 		else
 			continue;
 
+		if (filter)
+			filter->reset();
+
+		auto prev_time = steady_clock::now();
+
 		while (cfg["brt_auto"].get<bool>() && !quit) {
 
-			const int img_br = getScreenBrightness();
-			img_delta += abs(prev_img_br - img_br);
+			setActivity(screen_off, !screenActive());
+
+			if (inactive)
+				break;
+
+			const int  policy = cfg["brt_media_policy"];
+			const bool media  = policy != MEDIA_IGNORE && (fullscreenActive() || idle_inhibited);
+			int        poll   = cfg["brt_polling_rate"];
+
+			if (media != media_mode) {
+				media_mode = media;
+				LOGD << (media_mode ? "Media playback detected" : "Media playback ended");
+
+				if (media_mode) {
+					media_filter = std::make_unique<EmaFilter>(cfg["brt_media_tau"].get<double>());
+					media_filter->update(target_br, 0);
+				} else {
+					force = true;
+					if (filter)
+						filter->reset();
+				}
+			}
+
+			if (media_mode) {
+				if (policy == MEDIA_FREEZE) {
+					std::unique_lock<std::mutex> lock(m);
+					ss_cv.wait_for(lock, 1s, [&] { return quit; });
+					prev_time = steady_clock::now();
+					continue;
+				}
+
+				poll *= cfg["brt_media_rate_mult"].get<int>();
+			}
+
+			/* A different scene: skip both the smoothing and the hysteresis.
+			 * A frame requested before the change would still show the old one. */
+			if (scene_changed && !media_mode) {
+				discardCapture();
+				force = true;
+				if (filter)
+					filter->reset();
+			}
+
+			const int    img_br = getScreenBrightness();
+			const double noise  = brightnessConfidence();
+			const auto   now    = steady_clock::now();
+			const double dt     = duration<double>(now - prev_time).count();
+			prev_time = now;
+
+			// A new filter type, or new parameters for it
+			if (json settings = filterSettings(); settings != filter_settings) {
+				filter_settings = std::move(settings);
+				filter          = createFilter(cfg["brt_filter"]);
+				force           = true;
+			}
+
+			LumaFilter *f = (media_mode && policy == MEDIA_SLOW_AVERAGE) ? media_filter.get() : filter.get();
+
+			const int filtered = int(std::round(f->update(img_br, dt)));
+
+			/* The ambient light sets the brightness for a black screen,
+			 * the screen content lowers it from there. */
+			int ambient = brt_steps_max;
+#ifndef _WIN32
+			if (als.available()) {
+				const double w = std::clamp(cfg["als_weight"].get<double>(), 0., 1.);
+				ambient = int(std::lround(lerp(w, brt_steps_max, als.level() * brt_steps_max)));
+			}
+#endif
+			const int ambient_threshold = int(remap(cfg["brt_threshold"].get<int>(), 0, 255, 0, brt_steps_max));
+
+			if (std::abs(ambient - prev_ambient) > ambient_threshold)
+				force = true;
+
+			/* Hysteresis: a new target is issued only when the filtered
+			 * brightness leaves the band around the previous one.
+			 * The band is never narrower than the sampling error of the capture. */
+			const int band = std::max(cfg["brt_threshold"].get<int>(), int(std::ceil(noise)));
 
-			if (img_delta > cfg["brt_threshold"].get<int>() || force) {
+			if (std::abs(filtered - target_br) > band || force) {
 
-				img_delta = 0;
-				force = false;
+				force        = false;
+				target_br    = filtered;
+				prev_ambient = ambient;
 
 				{
 					std::lock_guard lock(brt_mtx);
-					this->ss_brightness = img_br;
+					this->ss_brightness = filtered;
+					this->ambient_step  = ambient;
 					br_needs_change = true;
 				}
 
@@ -149,15 +341,14 @@ void GammaCtl::captureScreen()
 			if (cfg["brt_min"] != prev_min || cfg["brt_max"] != prev_max || cfg["brt_offset"] != prev_offset)
 				force = true;
 
-			prev_img_br = img_br;
 			prev_min    = cfg["brt_min"];
 			prev_max    = cfg["brt_max"];
 			prev_offset = cfg["brt_offset"];
 
-			// On Windows, we sleep in getScreenBrightness()
-			if constexpr (!windows) {
-				std::this_thread::sleep_for(std::chrono::milliseconds(cfg["brt_polling_rate"].get<int>()));
-			}
+			/* Wakes up early when the scene changes. A follow-up sample is taken
+			 * shortly after, for windows that were mapped before being painted. */
+			const bool follow_up = scene_changed;
+			scene_changed = waitForEvent(follow_up ? std::min(poll, 150) : poll);
 		}
 	}
 
@@ -170,217 +361,232 @@ void GammaCtl::captureScreen()
 	brt_thr.join();
 }
 
+/**
+ * New targets are handed to a spring while it's moving, so the brightness
+ * keeps its velocity instead of restarting the animation. Between step
+ * changes (at most brt_fps per second) the thread sleeps.
+ */
 void GammaCtl::adjustBrightness(convar &brt_cv)
 {
-	using namespace std::this_thread;
 	using namespace std::chrono;
 
+	const auto origin = steady_clock::now();
+	const auto now    = [&] { return duration<double>(steady_clock::now() - origin).count(); };
+
+	Spring spring(cfg["brt_step"], cfg["brt_speed"].get<double>() / 1000);
+	bool   moving = false;
+	auto   wake   = origin;
+
 	while (true) {
-		int img_br;
+		bool new_target;
+		int  img_br;
+		int  ambient;
 
 		{
 			std::unique_lock<std::mutex> lock(brt_mtx);
 
-			brt_cv.wait(lock, [&] {
+			const auto pred = [&] {
 				return br_needs_change;
-			});
+			};
+
+			if (moving)
+				brt_cv.wait_until(lock, wake, pred);
+			else
+				brt_cv.wait(lock, pred);
 
 			if (quit)
 				break;
 
+			new_target      = br_needs_change;
 			br_needs_change = false;
-			img_br = this->ss_brightness;
+			img_br  = this->ss_brightness;
+			ambient = this->ambient_step;
 		}
 
-		const int cur_step = cfg["brt_step"];
-		const int tmp = brt_steps_max
-		                - int(remap(img_br, 0, 255, 0, brt_steps_max))
-		                + int(remap(cfg["brt_offset"].get<int>(), 0, brt_steps_max, 0, cfg["brt_max"].get<int>()));
-		const int target_step = std::clamp(tmp, cfg["brt_min"].get<int>(), cfg["brt_max"].get<int>());
+		if (new_target) {
+			const int cur_step = cfg["brt_step"];
+			const int tmp = ambient
+			                - int(remap(img_br, 0, 255, 0, ambient))
+			                + int(remap(cfg["brt_offset"].get<int>(), 0, brt_steps_max, 0, cfg["brt_max"].get<int>()));
+			const int target_step = std::clamp(tmp, cfg["brt_min"].get<int>(), cfg["brt_max"].get<int>());
 
-		if (cur_step == target_step) {
-			LOGV << "Brt already at target (" << target_step << ')';
-			continue;
-		}
+			if (!moving && cur_step == target_step) {
+				LOGV << "Brt already at target (" << target_step << ')';
+				continue;
+			}
 
-		double time             = 0;
-		const int FPS           = cfg["brt_fps"];
-		const double slice      = 1. / FPS;
-		const double duration_s = cfg["brt_speed"].get<double>() / 1000;
-		const int diff          = target_step - cur_step;
+			// At rest, the step may have been changed by hand
+			if (!moving)
+				spring.reset(cur_step, now());
 
-		while (cfg["brt_step"].get<int>() != target_step) {
+			spring.retarget(target_step, now(), cfg["brt_speed"].get<double>() / 1000);
+			moving = true;
+		}
 
-			if (br_needs_change || !cfg["brt_auto"].get<bool>() || quit)
-				break;
+		if (!cfg["brt_auto"].get<bool>() || inactive) {
+			moving = false;
+			continue;
+		}
 
-			time += slice;
-			cfg["brt_step"] = int(std::round(easeOutExpo(time, cur_step, diff, duration_s)));
+		const double t    = now();
+		const int    step = spring.stepAt(t);
 
-			setGamma(cfg["brt_step"], cfg["temp_step"]);
+		if (step != cfg["brt_step"].get<int>()) {
+			cfg["brt_step"] = step;
+			setGamma(step, cfg["temp_step"]);
 			mediator->notify(this, BRT_CHANGED);
-			sleep_for(milliseconds(1000 / FPS));
 		}
+
+		const double next = spring.nextStepTime(t);
+
+		if (std::isinf(next)) {
+			moving = false;
+			continue;
+		}
+
+		const auto frame = microseconds(1000000 / cfg["brt_fps"].get<int>());
+		wake = std::max(origin + duration_cast<steady_clock::duration>(duration<double>(next)), steady_clock::now() + frame);
 	}
 }
 
 /**
  * The temperature is adjusted in two steps.
  * The first one is for quickly catching up to the proper temperature when:
- * - time is checked sometime after the start time
+ * - a keyframe boundary is reached
  * - the system wakes up
  * - temperature settings change
+ * Then, while a transition of the schedule is under way, the temperature
+ * follows it. Otherwise the thread sleeps until the next transition starts.
  */
 void GammaCtl::adjustTemperature()
 {
-	using namespace std::this_thread;
 	using namespace std::chrono;
 	using namespace std::chrono_literals;
 
-	QTime start_time;
-	QTime end_time;
+	TempCurve curve;
 
-	const auto setTime = [] (QTime &t, const std::string &time_str) {
-		const auto start_h = time_str.substr(0, 2);
-		const auto start_m = time_str.substr(3, 2);
-		t = QTime(std::stoi(start_h), std::stoi(start_m));
+	const auto toStep = [] (int kelvin) {
+		return int(std::lround(remap(kelvin, temp_k_max, temp_k_min, temp_steps_max, 0)));
 	};
 
-	const auto updateInterval = [&] {
-		std::string t_start = cfg["temp_sunset"];
-		const int h = std::stoi(t_start.substr(0, 2));
-		const int m = std::stoi(t_start.substr(3, 2));
-
-		const int adapt_time_s = cfg["temp_speed"].get<double>() * 60;
-		const QTime adapted_start = QTime(h, m).addSecs(-adapt_time_s);
-
-		setTime(start_time, adapted_start.toString().toStdString());
-		setTime(end_time, cfg["temp_sunrise"]);
+	const auto fromStep = [] (double step) {
+		return remap(step, temp_steps_max, 0, temp_k_max, temp_k_min);
 	};
 
-	updateInterval();
+	// Checked again after at most this long, to pick up DST and clock changes
+	constexpr auto max_sleep = 1h;
 
-	bool needs_change = cfg["temp_auto"];
+	auto wake_time = system_clock::now();
 
-	convar     clock_cv;
-	std::mutex clock_mtx;
 	std::mutex temp_mtx;
 
-	std::thread clock ([&] {
-		while (true) {
-			{
-				std::unique_lock<std::mutex> lk(clock_mtx);
-				clock_cv.wait_until(lk, system_clock::now() + 60s, [&] {
-					return quit;
-				});
-			}
-
-			if (quit)
-				break;
-
-			if (!cfg["temp_auto"])
-				continue;
-
-			{
-				std::lock_guard<std::mutex> lock(temp_mtx);
-				needs_change = true; // @TODO: Should be false if the state hasn't changed
-			}
-
-			temp_cv.notify_one();
-		}
-	});
-
-	bool first_step_done = false;
+	// Catch-ups interrupted by a new target continue from where they were
+	const auto origin = steady_clock::now();
+	const auto now    = [&] { return duration<double>(steady_clock::now() - origin).count(); };
+	Spring     catchup(cfg["temp_step"], 2);
+	bool       catching_up = false;
 
 	while (true) {
 		{
 			std::unique_lock<std::mutex> lock(temp_mtx);
 
-			temp_cv.wait(lock, [&] {
-				return needs_change || first_step_done || force_temp_change || quit;
+			temp_cv.wait_until(lock, wake_time, [&] {
+				return force_temp_change || quit;
 			});
 
 			if (quit)
 				break;
 
 			if (force_temp_change) {
-				updateInterval();
+				curve.invalidate();
 				force_temp_change = false;
-				first_step_done = false;
 			}
-
-			needs_change = false;
 		}
 
+		wake_time = system_clock::now() + max_sleep;
+
 		if (!cfg["temp_auto"])
 			continue;
 
+		// We catch up when resuming
+		if (inactive)
+			continue;
 
-		int    target_temp = cfg["temp_low"]; // Temperature target in Kelvin
-		double duration_s  = 2;               // Seconds it takes to reach it
+		const int  FPS   = cfg["temp_fps"];
+		const auto frame = microseconds(1000000 / FPS);
 
-		const double    adapt_time_s = cfg["temp_speed"].get<double>() * 60;
-		const QDateTime cur_datetime = QDateTime::currentDateTime();
-		const QTime     cur_time     = cur_datetime.time();
+		const auto interrupted = [&] {
+			return force_temp_change || !cfg["temp_auto"].get<bool>() || inactive || quit;
+		};
 
-		if ((cur_time >= start_time) || (cur_time < end_time)) {
+		const auto apply = [&] (int step) {
+			if (step != cfg["temp_step"].get<int>()) {
+				cfg["temp_step"] = step;
+				setGamma(cfg["brt_step"], step);
+				mediator->notify(this, TEMP_CHANGED);
+			}
+		};
 
-			QDateTime start_datetime(cur_datetime.date(), start_time);
+		// Catch up with the current target
+		{
+			const int target_step = toStep(curve.kelvinAt(std::time(nullptr)));
 
-			/* If we are earlier than both sunset and sunrise times
-			 * we need to count from yesterday. */
-			if (cur_time < end_time)
-				start_datetime = start_datetime.addDays(-1);
+			if (!catching_up)
+				catchup.reset(cfg["temp_step"], now());
 
-			int secs_from_start = start_datetime.secsTo(cur_datetime);
+			catchup.retarget(target_step, now(), 2);
+			catching_up = true;
 
-			LOGV << "secs_from_start: " << secs_from_start << " adapt_time_s: " << adapt_time_s;
+			while (!interrupted()) {
 
-			if (secs_from_start > adapt_time_s)
-				secs_from_start = adapt_time_s;
+				const double t = now();
 
-			if (!first_step_done) {
-				target_temp = remap(secs_from_start, 0, adapt_time_s, cfg["temp_high"], cfg["temp_low"]);
-			} else {
-				duration_s = adapt_time_s - secs_from_start;
-				if (duration_s < 2)
-					duration_s = 2;
-			}
-		} else {
-			target_temp = cfg["temp_high"];
-		}
+				apply(catchup.stepAt(t));
 
-		LOGV << "Temp duration: " << duration_s / 60 << " min";
+				const double next = catchup.nextStepTime(t);
 
-		int cur_step    = cfg["temp_step"];
-		int target_step = int(remap(target_temp, temp_k_max, temp_k_min, temp_steps_max, 0));
+				if (std::isinf(next)) {
+					catching_up = false;
+					break;
+				}
 
-		if (cur_step == target_step) {
-			first_step_done = false;
-			continue;
+				std::unique_lock lock(temp_mtx);
+				temp_cv.wait_until(lock, std::max(origin + duration_cast<steady_clock::duration>(duration<double>(next)), steady_clock::now() + frame), [&] {
+					return force_temp_change || quit;
+				});
+			}
+
+			// Only a new target keeps the spring's velocity
+			if (!force_temp_change)
+				catching_up = false;
 		}
 
-		double time        = 0;
-		const int FPS      = cfg["temp_fps"];
-		const double slice = 1. / FPS;
-		const int diff     = target_step - cur_step;
+		/* Follow the transition in real time. The thread only wakes
+		 * when the temperature crosses into the next step. */
+		while (!interrupted()) {
 
-		while (cfg["temp_step"].get<int>() != target_step) {
+			const time_t now = std::time(nullptr);
 
-			if (force_temp_change || !cfg["temp_auto"].get<bool>() || quit)
+			if (!curve.changing(now))
 				break;
 
-			time += slice;
-			cfg["temp_step"] = int(easeInOutQuad(time, cur_step, diff, duration_s));
+			const int step = toStep(curve.kelvinAt(now));
+			apply(step);
+
+			const time_t next = curve.leaveTime(fromStep(step - 0.5), fromStep(step + 0.5), now);
 
-			setGamma(cfg["brt_step"], cfg["temp_step"]);
-			mediator->notify(this, TEMP_CHANGED);
-			sleep_for(milliseconds(1000 / FPS));
+			std::unique_lock lock(temp_mtx);
+			temp_cv.wait_until(lock, system_clock::from_time_t(std::max(next, now + 1)), [&] {
+				return force_temp_change || quit;
+			});
 		}
 
-		first_step_done = true;
-	}
+		const time_t now  = std::time(nullptr);
+		const time_t next = curve.nextChange(now);
 
-	clock_cv.notify_one();
-	clock.join();
+		if (next > now) {
+			wake_time = std::min(system_clock::from_time_t(next), system_clock::now() + max_sleep);
+			LOGV << "Next temperature change in " << (next - now) / 60 << " min";
+		}
+	}
 }
@@ -8,10 +8,18 @@
 
 #include <vector>
 #include <thread>
+#include <atomic>
+#include <chrono>
 #include "defs.h"
 
 #ifdef _WIN32
 #include "dspctl-dxgi.h"
+#elif defined(GAMMY_WAYLAND)
+#include "dspctl-wayland.h"
+#elif defined(GAMMY_DRM)
+#include "dspctl-drm.h"
+#elif defined(GAMMY_XCB)
+#include "dspctl-xcb.h"
 #else
 #include "dspctl-xlib.h"
 #undef Status
@@ -22,6 +30,11 @@
 
 #include "component.h"
 
+#ifndef _WIN32
+#include "backlight.h"
+#include "als.h"
+#endif
+
 class GammaCtl : public DspCtl, public Component
 {
 public:
@@ -32,12 +45,19 @@ public:
 
 	void notify_ss();
 	void notify_temp(bool force = false);
+	void notify_lock(bool locked);
+	void notify_sleep(bool sleeping);
+	void notify_inhibit(bool inhibited);
+
+	void setGamma(int brt, int temp);
+	void setInitialGamma(bool set_previous);
 private:
 	void captureScreen();
 	void adjustBrightness(convar &br_cv);
 	void adjustTemperature();
 	void reapplyGamma();
 	void notify_all_threads();
+	void setActivity(bool &flag, bool val);
 
 	std::vector<std::thread> threads;
 	convar ss_cv;
@@ -45,9 +65,30 @@ private:
 	convar reapply_cv;
 	std::mutex brt_mtx;
 	int ss_brightness = 0;
+	int ambient_step  = brt_steps_max; // Brightness the ambient light calls for
 	bool br_needs_change   = false;
 	bool force_temp_change = false;
 	bool quit              = false;
+
+	// Also set by the backlight writer thread
+	std::atomic<bool> force_reapply = false;
+
+	/* Capture, reduction and ramp uploads are suspended while
+	 * the screen is off, the session is locked or the system sleeps. */
+	std::atomic<bool> inactive = false;
+	std::mutex activity_mtx;
+	std::chrono::steady_clock::time_point inactive_since;
+	bool screen_off = false;
+	bool locked     = false;
+	bool asleep     = false;
+
+	// An application (usually a media player) is inhibiting the screensaver
+	std::atomic<bool> idle_inhibited = false;
+
+#ifndef _WIN32
+	Backlight    backlight;
+	AmbientLight als;
+#endif
 };
 
 #endif // GAMMACTL_H
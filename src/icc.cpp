@@ -0,0 +1,115 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include "icc.h"
+#include "ramp.h"
+#include "defs.h"
+
+/* ICC profiles are big endian */
+static uint32_t be32(const uint8_t *p)
+{
+	return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+}
+
+static uint16_t be16(const uint8_t *p)
+{
+	return uint16_t(p[0] << 8 | p[1]);
+}
+
+/**
+ * Reads the video card gamma table (the Apple 'vcgt' tag) of an ICC profile
+ * into a 3-channel ramp of 'size' entries. Both the table and the formula
+ * variants are supported.
+ */
+bool loadVcgt(const std::string &path, int size, std::vector<uint16_t> &ramp)
+{
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file.is_open()) {
+		LOGE << "Unable to open ICC profile: " << path;
+		return false;
+	}
+
+	const std::vector<uint8_t> d((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	if (d.size() < 132 || be32(&d[36]) != 0x61637370) { // 'acsp'
+		LOGE << "Not an ICC profile: " << path;
+		return false;
+	}
+
+	const uint32_t tag_count = be32(&d[128]);
+	uint64_t off = 0, len = 0;
+
+	for (uint32_t i = 0; i < tag_count && 132 + 12 * uint64_t(i + 1) <= d.size(); ++i) {
+		const uint8_t *t = &d[132 + 12 * i];
+
+		if (be32(t) == 0x76636774) { // 'vcgt'
+			off = be32(t + 4);
+			len = be32(t + 8);
+			break;
+		}
+	}
+
+	if (len < 12 || off + len > d.size()) {
+		LOGW << "No VCGT tag in: " << path;
+		return false;
+	}
+
+	const uint8_t *v   = &d[off];
+	const uint32_t type = be32(v + 8);
+
+	ramp.resize(3 * size);
+
+	if (type == 0) {
+		if (len < 18)
+			return false;
+
+		const int channels   = be16(v + 12);
+		const int entries    = be16(v + 14);
+		const int entry_size = be16(v + 16);
+
+		if (channels != 3 || entries < 2 || (entry_size != 1 && entry_size != 2)
+		    || 18 + uint64_t(channels) * entries * entry_size > len) {
+			LOGE << "Unsupported VCGT table: " << channels << " channels, " << entries << " * " << entry_size << " bytes";
+			return false;
+		}
+
+		std::vector<uint16_t> table(3 * entries);
+
+		for (int i = 0; i < 3 * entries; ++i) {
+			const uint8_t *e = v + 18 + i * entry_size;
+			table[i] = entry_size == 2 ? be16(e) : uint16_t(*e * 257);
+		}
+
+		resampleRamp(table.data(), entries, ramp.data(), size);
+
+	} else if (type == 1) {
+		if (len < 12 + 36)
+			return false;
+
+		// Per channel: gamma, min and max, as s15Fixed16
+		for (int c = 0; c < 3; ++c) {
+			const double gamma = int32_t(be32(v + 12 + c * 12 + 0)) / 65536.;
+			const double min   = int32_t(be32(v + 12 + c * 12 + 4)) / 65536.;
+			const double max   = int32_t(be32(v + 12 + c * 12 + 8)) / 65536.;
+
+			for (int i = 0; i < size; ++i) {
+				const double x = size > 1 ? double(i) / (size - 1) : 1;
+				const double y = min + (max - min) * std::pow(x, gamma);
+				ramp[c * size + i] = uint16_t(std::clamp(y, 0., 1.) * UINT16_MAX + 0.5);
+			}
+		}
+	} else {
+		LOGE << "Unknown VCGT type: " << type;
+		return false;
+	}
+
+	LOGI << "Loaded VCGT from: " << path;
+	return true;
+}
@@ -0,0 +1,15 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef ICC_H
+#define ICC_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+bool loadVcgt(const std::string &path, int size, std::vector<uint16_t> &ramp);
+
+#endif // ICC_H
@@ -0,0 +1,120 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "luma.h"
+
+void LumaHistogram::clear()
+{
+	count.fill(0);
+	sum     = 0;
+	samples = 0;
+	reads   = 0;
+}
+
+void LumaHistogram::merge(const LumaHistogram &h)
+{
+	for (int i = 0; i < bins; ++i)
+		count[i] += h.count[i];
+
+	sum     += h.sum;
+	samples += h.samples;
+	reads   += h.reads;
+}
+
+int LumaHistogram::mean() const
+{
+	if (samples == 0)
+		return 0;
+
+	return int(sum / samples);
+}
+
+/**
+ * Returns the smallest luma value below which at least p percent
+ * of the samples fall. p = 50 gives the median.
+ */
+int LumaHistogram::percentile(double p) const
+{
+	if (samples == 0)
+		return 0;
+
+	p = std::clamp(p, 0., 100.);
+
+	const uint64_t rank = std::max(uint64_t(1), uint64_t(std::ceil(samples * p / 100)));
+	uint64_t acc = 0;
+
+	for (int i = 0; i < bins; ++i) {
+		acc += count[i];
+		if (acc >= rank)
+			return i;
+	}
+
+	return bins - 1;
+}
+
+/**
+ * Average picture level with highlights weighted more heavily.
+ * Each bin is weighted by 1 + highlight_weight * (luma / 255)^2, so that
+ * a small bright area pulls the result up more than it would in a plain mean.
+ */
+int LumaHistogram::apl(double highlight_weight) const
+{
+	if (samples == 0)
+		return 0;
+
+	double num = 0;
+	double den = 0;
+
+	for (int i = 0; i < bins; ++i) {
+		if (count[i] == 0)
+			continue;
+
+		const double n = double(i) / (bins - 1);
+		const double w = (1 + highlight_weight * n * n) * count[i];
+
+		num += w * i;
+		den += w;
+	}
+
+	return int(std::round(num / den));
+}
+
+/**
+ * Half width of the confidence interval of the mean (95% by default),
+ * from the spread of the histogram and the number of pixels read.
+ * Quasi-random and grid samples converge faster than random ones,
+ * so for those it's an upper bound.
+ */
+double LumaHistogram::confidence(double z) const
+{
+	if (reads < 2 || samples == 0)
+		return 0;
+
+	const double m = double(sum) / samples;
+	double var = 0;
+
+	for (int i = 0; i < bins; ++i)
+		var += count[i] * (i - m) * (i - m);
+
+	var /= samples;
+
+	return z * std::sqrt(var / reads);
+}
+
+int lumaMetric(const LumaHistogram &h, int metric, double percentile, double highlight_weight)
+{
+	switch (metric) {
+	case LUMA_MEDIAN:
+		return h.percentile(50);
+	case LUMA_PERCENTILE:
+		return h.percentile(percentile);
+	case LUMA_APL:
+		return h.apl(highlight_weight);
+	default:
+		return h.mean();
+	}
+}
@@ -0,0 +1,75 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef LUMA_H
+#define LUMA_H
+
+#include <array>
+#include <cstdint>
+
+/**
+ * Metrics used to reduce the luma histogram to a single brightness value.
+ * Stored in the config as "brt_metric".
+ */
+enum LumaMetric {
+	LUMA_MEAN,
+	LUMA_MEDIAN,
+	LUMA_PERCENTILE,
+	LUMA_APL,
+	LUMA_METRIC_COUNT
+};
+
+/**
+ * Parts of the screen used for sampling. Stored in the config as "brt_region".
+ */
+enum SampleRegion {
+	REGION_FULL,
+	REGION_ACTIVE_WINDOW,
+	REGION_CENTER_WEIGHTED,
+	REGION_COUNT
+};
+
+/**
+ * Histogram of 8-bit Rec.709 luma values.
+ * Built in the same pass that used to compute the plain mean.
+ */
+struct LumaHistogram
+{
+	static constexpr int bins = 256;
+
+	std::array<uint32_t, bins> count {};
+	uint64_t sum     = 0;
+	uint64_t samples = 0; // Sum of the weights
+	uint64_t reads   = 0; // Pixels actually read
+
+	void add(int luma, uint32_t weight = 1)
+	{
+		count[luma] += weight;
+		sum         += uint64_t(luma) * weight;
+		samples     += weight;
+		++reads;
+	}
+
+	void clear();
+	void merge(const LumaHistogram &h);
+
+	int mean() const;
+	int percentile(double p) const;
+	int apl(double highlight_weight) const;
+	double confidence(double z = 1.96) const;
+};
+
+/**
+ * Integer Rec.709 luma. Weights are scaled by 256 and sum to 256,
+ * so a white pixel maps to exactly 255.
+ */
+inline int luma709(int r, int g, int b)
+{
+	return (54 * r + 183 * g + 19 * b + 128) >> 8;
+}
+
+int lumaMetric(const LumaHistogram &h, int metric, double percentile, double highlight_weight);
+
+#endif // LUMA_H
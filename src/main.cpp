@@ -6,6 +6,7 @@
 #include <QApplication>
 #include <plog/Appenders/ColorConsoleAppender.h>
 #include <plog/Appenders/RollingFileAppender.h>
+#include "asyncappender.h"
 #include "cfg.h"
 #include "utils.h"
 #include "mainwindow.h"
@@ -26,10 +27,12 @@ void init()
 {
 	static plog::RollingFileAppender<plog::TxtFormatter> f("gammylog.txt", 1024 * 1024 * 5, 1);
 	static plog::ColorConsoleAppender<plog::TxtFormatter> c;
-	plog::init(plog::Severity(plog::debug), &c);
+
+	// Formatting and writes happen on the appender's thread
+	static AsyncAppender a({ &c, &f });
+	plog::init(plog::Severity(plog::debug), &a);
 
 	const auto logger = plog::get();
-	logger->addAppender(&f);
 	config::read();
 	logger->setMaxSeverity(plog::Severity(cfg["log_level"]));
 
@@ -11,6 +11,8 @@
 #include <QMenu>
 #include <QtDBus/QDBusInterface>
 #include <QtDBus/QDBusConnection>
+#include <QtDBus/QDBusReply>
+#include <QtDBus/QDBusObjectPath>
 #include <QShortcut>
 #include "cfg.h"
 #include "mainwindow.h"
@@ -36,6 +38,14 @@ void MainWindow::init()
 		LOGE << "Gammy is unable to reset the proper brightness / temperature when resuming from suspend.";
 	}
 
+	if (!windows && !listenLockSignals()) {
+		LOGW << "Gammy is unable to pause while the session is locked.";
+	}
+
+	if (!windows && !listenInhibitSignals()) {
+		LOGW << "Gammy is unable to detect media playback through screensaver inhibitors.";
+	}
+
 	setLabels();
 	setSliders();
 	toggleBrtSliders(cfg["brt_auto"]);
@@ -200,13 +210,116 @@ bool MainWindow::listenWakeupSignal()
 	return true;
 }
 
+/**
+ * Listens to the Lock/Unlock signals of our logind session.
+ */
+bool MainWindow::listenLockSignals()
+{
+	QDBusConnection dbus = QDBusConnection::systemBus();
+
+	if (!dbus.isConnected())
+		return false;
+
+	const QString service   = "org.freedesktop.login1";
+	const QString interface = "org.freedesktop.login1.Session";
+
+	QDBusInterface manager(service, "/org/freedesktop/login1", "org.freedesktop.login1.Manager", dbus, this);
+
+	if (!manager.isValid()) {
+		LOGE << "logind manager interface not found.";
+		return false;
+	}
+
+	QDBusReply<QDBusObjectPath> reply = manager.call("GetSessionByPID", uint(QCoreApplication::applicationPid()));
+
+	if (!reply.isValid()) {
+		LOGE << "Cannot get the logind session: " << reply.error().message().toStdString();
+		return false;
+	}
+
+	const QString path = reply.value().path();
+
+	LOGD << "logind session: " << path.toStdString();
+
+	return dbus.connect(service, path, interface, "Lock", this, SLOT(lockSlot()))
+	    && dbus.connect(service, path, interface, "Unlock", this, SLOT(unlockSlot()));
+}
+
+/**
+ * Media players inhibit the screensaver while playing.
+ * We follow the freedesktop inhibit interface, or GNOME's session manager.
+ */
+bool MainWindow::listenInhibitSignals()
+{
+	QDBusConnection dbus = QDBusConnection::sessionBus();
+
+	if (!dbus.isConnected()) {
+		LOGE << "Cannot connect to the session D-Bus.";
+		return false;
+	}
+
+	{
+		const QString service   = "org.freedesktop.PowerManagement";
+		const QString path      = "/org/freedesktop/PowerManagement/Inhibit";
+		const QString interface = "org.freedesktop.PowerManagement.Inhibit";
+
+		QDBusInterface iface(service, path, interface, dbus, this);
+
+		if (iface.isValid() && dbus.connect(service, path, interface, "HasInhibitChanged", this, SLOT(inhibitSlot(bool)))) {
+			QDBusReply<bool> reply = iface.call("HasInhibit");
+			if (reply.isValid())
+				inhibitSlot(reply.value());
+			return true;
+		}
+	}
+
+	const QString service   = "org.gnome.SessionManager";
+	const QString path      = "/org/gnome/SessionManager";
+	const QString interface = "org.gnome.SessionManager";
+
+	QDBusInterface iface(service, path, interface, dbus, this);
+
+	if (!iface.isValid())
+		return false;
+
+	const bool connected = dbus.connect(service, path, interface, "InhibitorAdded", this, SLOT(gnomeInhibitSlot(QDBusObjectPath)))
+	                    && dbus.connect(service, path, interface, "InhibitorRemoved", this, SLOT(gnomeInhibitSlot(QDBusObjectPath)));
+
+	if (connected)
+		gnomeInhibitSlot(QDBusObjectPath());
+
+	return connected;
+}
+
+void MainWindow::inhibitSlot(bool inhibited)
+{
+	mediator->notify(this, inhibited ? IDLE_INHIBITED : IDLE_UNINHIBITED);
+}
+
+void MainWindow::gnomeInhibitSlot([[maybe_unused]] const QDBusObjectPath &inhibitor)
+{
+	// 8: inhibit the session being marked as idle
+	QDBusInterface iface("org.gnome.SessionManager", "/org/gnome/SessionManager", "org.gnome.SessionManager", QDBusConnection::sessionBus(), this);
+	QDBusReply<bool> reply = iface.call("IsInhibited", uint(8));
+
+	if (reply.isValid())
+		inhibitSlot(reply.value());
+}
+
 void MainWindow::wakeupSlot(bool status)
 {
-	// The signal emits TRUE when going to sleep. We only care about wakeup (FALSE)
-	if (status)
-		return;
+	// The signal emits TRUE when going to sleep, FALSE on wakeup
+	mediator->notify(this, status ? SYSTEM_SLEEP : SYSTEM_WAKE_UP);
+}
 
-	mediator->notify(this, SYSTEM_WAKE_UP);
+void MainWindow::lockSlot()
+{
+	mediator->notify(this, SESSION_LOCKED);
+}
+
+void MainWindow::unlockSlot()
+{
+	mediator->notify(this, SESSION_UNLOCKED);
 }
 
 void MainWindow::shutdown()
@@ -313,18 +426,69 @@ QMenu* MainWindow::createTrayMenu()
 }
 
 /**
- * These are called by the mediator when brt/temp is getting adjusted.
- * Triggers a valueChanged, but not a sliderMoved. This allows us
- * to differentiate between app and user action.
+ * These are called by the mediator when brt/temp is getting adjusted,
+ * from the gamma controller's threads, once per animation frame.
+ * Only the latest value is kept: the GUI thread picks it up later.
  */
 void MainWindow::setBrtSlider(int val)
 {
-	ui->brtSlider->setValue(val);
+	brt_mailbox.store(val, std::memory_order_relaxed);
+	postSliders();
 }
 
 void MainWindow::setTempSlider(int val)
 {
-	ui->tempSlider->setValue(val);
+	temp_mailbox.store(val, std::memory_order_relaxed);
+	postSliders();
+}
+
+void MainWindow::postSliders()
+{
+	if (!wnd_visible.load(std::memory_order_relaxed))
+		return;
+
+	// A call is already queued and will read the new value
+	if (sliders_queued.exchange(true))
+		return;
+
+	QMetaObject::invokeMethod(this, [this] { applySliders(); }, Qt::QueuedConnection);
+}
+
+/**
+ * Triggers a valueChanged, but not a sliderMoved. This allows us
+ * to differentiate between app and user action.
+ */
+void MainWindow::applySliders()
+{
+	sliders_queued = false;
+
+	const int brt  = brt_mailbox.load(std::memory_order_relaxed);
+	const int temp = temp_mailbox.load(std::memory_order_relaxed);
+
+	if (brt != -1 && brt != ui->brtSlider->value())
+		ui->brtSlider->setValue(brt);
+
+	if (temp != -1 && temp != ui->tempSlider->value())
+		ui->tempSlider->setValue(temp);
+}
+
+/**
+ * Nothing is posted while hidden, so the sliders catch up here.
+ * The mailboxes may be older than a manual change, hence the config.
+ */
+void MainWindow::showEvent(QShowEvent *e)
+{
+	brt_mailbox  = cfg["brt_step"].get<int>();
+	temp_mailbox = cfg["temp_step"].get<int>();
+	wnd_visible  = true;
+	applySliders();
+	QMainWindow::showEvent(e);
+}
+
+void MainWindow::hideEvent(QHideEvent *e)
+{
+	wnd_visible = false;
+	QMainWindow::hideEvent(e);
 }
 
 /**
@@ -525,6 +689,17 @@ void MainWindow::setPollingRange(int min, int max)
 	ui->pollingSlider->setValue(poll);
 }
 
+/**
+ * For backends that can't capture the screen.
+ */
+void MainWindow::disableAutoBrt()
+{
+	ui->autoBrtCheck->setChecked(false);
+	ui->autoBrtCheck->setEnabled(false);
+	ui->autoBrtCheck->setToolTip("Screen capture is not supported by this backend");
+	tray_brt_toggle->setEnabled(false);
+}
+
 MainWindow::~MainWindow()
 {
 	delete ui;
@@ -10,6 +10,8 @@
 #include <QMainWindow>
 #include <QSystemTrayIcon>
 #include <QAbstractSlider>
+#include <QtDBus/QDBusObjectPath>
+#include <atomic>
 
 #include "component.h"
 #include "mediator.h"
@@ -31,6 +33,7 @@ public:
 	void setTempSlider(int);
 	void setBrtSlider(int);
 	void setPollingRange(int, int);
+	void disableAutoBrt();
 	void shutdown();
 
 private slots:
@@ -56,12 +59,18 @@ private slots:
 
 	void on_advBrSettingsBtn_toggled(bool checked);
 	void wakeupSlot(bool);
+	void lockSlot();
+	void unlockSlot();
+	void inhibitSlot(bool);
+	void gnomeInhibitSlot(const QDBusObjectPath &);
 private:
 	Ui::MainWindow  *ui;
 	QSystemTrayIcon *tray_icon;
 	QMenu *createTrayMenu();
 
 	bool listenWakeupSignal();
+	bool listenLockSignals();
+	bool listenInhibitSignals();
 	void setWindowProperties(QIcon &icon);
 	void setLabels();
 	void setSliders();
@@ -70,11 +79,23 @@ private:
 	void updateBrtLabel(int);
 	void updateTempLabel(int);
 	void closeEvent(QCloseEvent *);
+	void showEvent(QShowEvent *);
+	void hideEvent(QHideEvent *);
 	void setPos();
 	void savePos();
 	void restoreDefaultBrt();
 	void restoreDefaultTemp();
 
+	/* Latest slider values posted by the gamma controller's threads.
+	 * They're applied by at most one queued call per event loop pass,
+	 * and not at all while the window is hidden. */
+	std::atomic_int  brt_mailbox    {-1};
+	std::atomic_int  temp_mailbox   {-1};
+	std::atomic_bool sliders_queued {false};
+	std::atomic_bool wnd_visible    {false};
+	void postSliders();
+	void applySliders();
+
 	void createTrayIcon(QIcon &icon);
 	void checkTray();
 	bool systray_available = false;
@@ -15,6 +15,9 @@ Mediator::Mediator(GammaCtl *g, MainWindow *w) : gammactl(g), wnd(w)
 
 	gammactl->start();
 	wnd->init();
+
+	if (!gammactl->captureSupported())
+		wnd->disableAutoBrt();
 }
 
 void Mediator::notify([[maybe_unused]] Component *sender, Component::Event e) const
@@ -37,8 +40,29 @@ void Mediator::notify([[maybe_unused]] Component *sender, Component::Event e) co
 		break;
 	case Component::SYSTEM_WAKE_UP:
 		LOGD << "System woke up from sleep";
+		gammactl->notify_sleep(false);
 		gammactl->notify_temp(true);
 		break;
+	case Component::SYSTEM_SLEEP:
+		LOGD << "System going to sleep";
+		gammactl->notify_sleep(true);
+		break;
+	case Component::SESSION_LOCKED:
+		LOGD << "Session locked";
+		gammactl->notify_lock(true);
+		break;
+	case Component::SESSION_UNLOCKED:
+		LOGD << "Session unlocked";
+		gammactl->notify_lock(false);
+		break;
+	case Component::IDLE_INHIBITED:
+		LOGD << "Idle inhibited";
+		gammactl->notify_inhibit(true);
+		break;
+	case Component::IDLE_UNINHIBITED:
+		LOGD << "Idle uninhibited";
+		gammactl->notify_inhibit(false);
+		break;
 	case Component::APP_QUIT:
 		gammactl->stop();
 		gammactl->setInitialGamma(true);
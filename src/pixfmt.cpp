@@ -0,0 +1,235 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "pixfmt.h"
+#include "luma.h"
+
+namespace {
+
+/* 8 bits per channel, each in its own byte (24 and 32 bpp). */
+template <int R, int G, int B, int Bytes>
+struct Bytes8
+{
+	static constexpr int bytes = Bytes;
+
+	static int luma(const PixelFormat &, const uint8_t *p)
+	{
+		return luma709(p[R], p[G], p[B]);
+	}
+};
+
+/* Channels packed in a 16 or 32-bit word of known byte order. */
+template <int Bytes, bool MSBFirst>
+uint32_t load(const uint8_t *p)
+{
+	uint32_t v = 0;
+
+	for (int i = 0; i < Bytes; ++i)
+		v |= uint32_t(p[i]) << (8 * (MSBFirst ? Bytes - 1 - i : i));
+
+	return v;
+}
+
+template <int Bits>
+int to8(uint32_t c)
+{
+	if constexpr (Bits >= 8)
+		return int(c >> (Bits - 8));
+	else
+		return int((c << (8 - Bits)) | (c >> (2 * Bits - 8)));
+}
+
+template <int Bytes, bool MSBFirst, int RS, int RB, int GS, int GB, int BS, int BB>
+struct Packed
+{
+	static constexpr int bytes = Bytes;
+
+	static int luma(const PixelFormat &, const uint8_t *p)
+	{
+		const uint32_t v = load<Bytes, MSBFirst>(p);
+
+		return luma709(to8<RB>((v >> RS) & ((1u << RB) - 1)),
+		               to8<GB>((v >> GS) & ((1u << GB) - 1)),
+		               to8<BB>((v >> BS) & ((1u << BB) - 1)));
+	}
+};
+
+/* Anything else: shifts and widths are read from the format at runtime. */
+template <int Bytes, bool MSBFirst>
+struct Generic
+{
+	static constexpr int bytes = Bytes;
+
+	static int luma(const PixelFormat &f, const uint8_t *p)
+	{
+		const uint32_t v = load<Bytes, MSBFirst>(p);
+		int c[3];
+
+		for (int i = 0; i < 3; ++i) {
+			const uint32_t max = (1u << f.bits[i]) - 1;
+			c[i] = max ? int(((v >> f.shift[i]) & max) * 255 / max) : 0;
+		}
+
+		return luma709(c[0], c[1], c[2]);
+	}
+};
+
+template <class Fmt>
+void sample(const PixelFormat &f, LumaHistogram &h, const uint8_t *buf, uint64_t buf_sz, int stride)
+{
+	const uint64_t inc = uint64_t(stride) * Fmt::bytes;
+
+	for (uint64_t i = 0; i + Fmt::bytes <= buf_sz; i += inc)
+		h.add(Fmt::luma(f, buf + i));
+}
+
+/**
+ * Samples a grid with roughly the same density as sample(),
+ * weighting pixels near the center of the image up to 16 times more
+ * than the ones outside the inscribed ellipse.
+ * The buffer can be a horizontal strip starting at row y_offset
+ * of an image that is full_height rows tall.
+ */
+template <class Fmt>
+void sampleCentered(const PixelFormat &f, LumaHistogram &h, const uint8_t *buf, int width, int height, int bytes_per_line, int stride, int y_offset, int full_height)
+{
+	const int    step = std::max(1, int(std::sqrt(stride)));
+	const double cx   = width / 2.,
+	             cy   = full_height / 2.;
+
+	// First row of the global grid inside this strip
+	int y = step / 2 - y_offset;
+	if (y < 0)
+		y += ((-y + step - 1) / step) * step;
+
+	for (; y < height; y += step) {
+
+		const double  dy  = (y + y_offset - cy) / cy;
+		const uint8_t *row = buf + uint64_t(y) * bytes_per_line;
+
+		for (int x = step / 2; x < width; x += step) {
+			const double   dx = (x - cx) / cx;
+			const double   d2 = dx * dx + dy * dy;
+			const uint32_t w  = 1 + uint32_t(15 * std::max(0., 1 - d2));
+
+			h.add(Fmt::luma(f, row + x * Fmt::bytes), w);
+		}
+	}
+}
+
+/**
+ * Reads only the given pixels. Their rows are relative to the full image,
+ * the buffer starts at row y_offset.
+ */
+template <class Fmt>
+void samplePoints(const PixelFormat &f, LumaHistogram &h, const uint8_t *buf, int bytes_per_line, const SamplePoint *points, uint64_t count, int y_offset)
+{
+	for (uint64_t i = 0; i < count; ++i) {
+		const SamplePoint &p = points[i];
+		h.add(Fmt::luma(f, buf + uint64_t(p.y - y_offset) * bytes_per_line + p.x * Fmt::bytes), p.weight);
+	}
+}
+
+template <class Fmt>
+PixelFormat make(PixelFormat f, const char *name)
+{
+	f.name           = name;
+	f.sample         = sample<Fmt>;
+	f.sampleCentered = sampleCentered<Fmt>;
+	f.samplePoints   = samplePoints<Fmt>;
+	return f;
+}
+
+int lowestBit(uint32_t m)
+{
+	int i = 0;
+	while (m && !(m & 1)) {
+		m >>= 1;
+		++i;
+	}
+	return i;
+}
+
+int countBits(uint32_t m)
+{
+	int n = 0;
+	for (; m; m &= m - 1)
+		++n;
+	return n;
+}
+
+template <bool MSBFirst>
+PixelFormat select(const PixelFormat &f)
+{
+	const int *s = f.shift;
+	const int *b = f.bits;
+
+	const auto is = [&] (int rs, int rb, int gs, int gb, int bs, int bb) {
+		return s[0] == rs && b[0] == rb && s[1] == gs && b[1] == gb && s[2] == bs && b[2] == bb;
+	};
+
+	// Position in memory of the byte holding bits [shift, shift + 8)
+	const auto byte = [&] (int shift) {
+		return MSBFirst ? f.bytes_per_pixel - 1 - shift / 8 : shift / 8;
+	};
+
+	if (b[0] == 8 && b[1] == 8 && b[2] == 8 && s[0] % 8 == 0 && s[1] % 8 == 0 && s[2] % 8 == 0) {
+
+		const int r = byte(s[0]), g = byte(s[1]), bl = byte(s[2]);
+
+		if (f.bytes_per_pixel == 4) {
+			if (r == 2 && g == 1 && bl == 0) return make<Bytes8<2, 1, 0, 4>>(f, "BGRX8888");
+			if (r == 0 && g == 1 && bl == 2) return make<Bytes8<0, 1, 2, 4>>(f, "RGBX8888");
+			if (r == 1 && g == 2 && bl == 3) return make<Bytes8<1, 2, 3, 4>>(f, "XRGB8888");
+			if (r == 3 && g == 2 && bl == 1) return make<Bytes8<3, 2, 1, 4>>(f, "XBGR8888");
+		} else if (f.bytes_per_pixel == 3) {
+			if (r == 2 && g == 1 && bl == 0) return make<Bytes8<2, 1, 0, 3>>(f, "BGR888");
+			if (r == 0 && g == 1 && bl == 2) return make<Bytes8<0, 1, 2, 3>>(f, "RGB888");
+		}
+	}
+
+	if (f.bytes_per_pixel == 4) {
+		if (is(20, 10, 10, 10, 0, 10)) return make<Packed<4, MSBFirst, 20, 10, 10, 10, 0, 10>>(f, "X2RGB10");
+		if (is(0, 10, 10, 10, 20, 10)) return make<Packed<4, MSBFirst, 0, 10, 10, 10, 20, 10>>(f, "X2BGR10");
+	}
+
+	if (f.bytes_per_pixel == 2) {
+		if (is(11, 5, 5, 6, 0, 5))   return make<Packed<2, MSBFirst, 11, 5, 5, 6, 0, 5>>(f, "RGB565");
+		if (is(0, 5, 5, 6, 11, 5))   return make<Packed<2, MSBFirst, 0, 5, 5, 6, 11, 5>>(f, "BGR565");
+		if (is(10, 5, 5, 5, 0, 5))   return make<Packed<2, MSBFirst, 10, 5, 5, 5, 0, 5>>(f, "XRGB1555");
+	}
+
+	switch (f.bytes_per_pixel) {
+	case 4:  return make<Generic<4, MSBFirst>>(f, "generic 32 bpp");
+	case 3:  return make<Generic<3, MSBFirst>>(f, "generic 24 bpp");
+	case 2:  return make<Generic<2, MSBFirst>>(f, "generic 16 bpp");
+	default: return make<Generic<1, MSBFirst>>(f, "generic 8 bpp");
+	}
+}
+
+} // namespace
+
+/**
+ * Picks the kernels for a visual. Masks are the ones of the pixel value,
+ * msb_first is the byte order of the image (MSBFirst in X11 terms).
+ */
+PixelFormat pixelFormat(int bits_per_pixel, uint32_t red_mask, uint32_t green_mask, uint32_t blue_mask, bool msb_first)
+{
+	PixelFormat f {};
+
+	f.bytes_per_pixel = std::clamp(bits_per_pixel / 8, 1, 4);
+	f.msb_first       = msb_first;
+
+	const uint32_t masks[3] { red_mask, green_mask, blue_mask };
+
+	for (int i = 0; i < 3; ++i) {
+		f.shift[i] = lowestBit(masks[i]);
+		f.bits[i]  = countBits(masks[i]);
+	}
+
+	return msb_first ? select<true>(f) : select<false>(f);
+}
@@ -0,0 +1,41 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef PIXFMT_H
+#define PIXFMT_H
+
+#include <cstdint>
+
+struct LumaHistogram;
+
+/* A pixel to sample and its weight in the histogram. */
+struct SamplePoint
+{
+	int      x;
+	int      y;
+	uint32_t weight;
+};
+
+/**
+ * Describes how RGB is stored in a captured image.
+ * The sampling kernels are specialized at compile time for the common formats
+ * and picked once per visual, so the inner loops never branch on the format.
+ */
+struct PixelFormat
+{
+	const char *name;
+	int  bytes_per_pixel;
+	bool msb_first;
+	int  shift[3]; // R, G, B
+	int  bits[3];
+
+	void (*sample)(const PixelFormat &f, LumaHistogram &h, const uint8_t *buf, uint64_t buf_sz, int stride);
+	void (*sampleCentered)(const PixelFormat &f, LumaHistogram &h, const uint8_t *buf, int width, int height, int bytes_per_line, int stride, int y_offset, int full_height);
+	void (*samplePoints)(const PixelFormat &f, LumaHistogram &h, const uint8_t *buf, int bytes_per_line, const SamplePoint *points, uint64_t count, int y_offset);
+};
+
+PixelFormat pixelFormat(int bits_per_pixel, uint32_t red_mask, uint32_t green_mask, uint32_t blue_mask, bool msb_first);
+
+#endif // PIXFMT_H
@@ -0,0 +1,131 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <algorithm>
+#include "ramp.h"
+#include "defs.h"
+#include "utils.h"
+#include "colortemp.h"
+
+/**
+ * Linear ramp from 0 to gain * UINT16_MAX, for any size:
+ * entry i is round(i / (size - 1) * gain * UINT16_MAX), clamped.
+ * So the last entry hits UINT16_MAX exactly at full gain, also for
+ * sizes that are not powers of two, and the error is at most half a step.
+ * The main loop has no branches, so it's vectorized.
+ */
+void fillRampChannel(uint16_t *out, int size, double gain)
+{
+	if (size <= 0)
+		return;
+
+	if (size == 1) {
+		out[0] = uint16_t(std::clamp(gain, 0., 1.) * UINT16_MAX + 0.5);
+		return;
+	}
+
+	constexpr double max = UINT16_MAX;
+	const double step = std::max(gain, 0.) * max / (size - 1);
+
+	// Entries from n on would overflow. They are clipped in a separate loop.
+	const int n = step > 0 ? int(std::min(double(size), max / step + 1)) : size;
+
+	for (int i = 0; i < n; ++i)
+		out[i] = uint16_t(int(i * step + 0.5));
+
+	std::fill(out + n, out + size, UINT16_MAX);
+}
+
+/**
+ * With brt_extend, brt_step goes past brt_steps_max:
+ * the ramp then clips at the top, as before.
+ */
+void fillGammaRamp(uint16_t *r, uint16_t *g, uint16_t *b, int size, int brt_step, int temp_step)
+{
+	const double brt = normalize(brt_step, 0, brt_steps_max);
+
+	fillRampChannel(r, size, brt * tempMultiplier(temp_step, 0));
+	fillRampChannel(g, size, brt * tempMultiplier(temp_step, 1));
+	fillRampChannel(b, size, brt * tempMultiplier(temp_step, 2));
+}
+
+/**
+ * Scales a base curve, e.g. a calibration ramp.
+ * At full gain the output is the base itself.
+ */
+void scaleRampChannel(uint16_t *out, const uint16_t *base, int size, double gain)
+{
+	constexpr double max = UINT16_MAX;
+	gain = std::max(gain, 0.);
+
+	for (int i = 0; i < size; ++i) {
+		const double v = base[i] * gain + 0.5;
+		out[i] = uint16_t(v < max ? v : max);
+	}
+}
+
+/**
+ * Like fillGammaRamp, on top of a base curve of 3 * size entries (R, G, B).
+ */
+void composeGammaRamp(uint16_t *r, uint16_t *g, uint16_t *b, const uint16_t *base, int size, int brt_step, int temp_step)
+{
+	const double brt = normalize(brt_step, 0, brt_steps_max);
+
+	scaleRampChannel(r, &base[0 * size], size, brt * tempMultiplier(temp_step, 0));
+	scaleRampChannel(g, &base[1 * size], size, brt * tempMultiplier(temp_step, 1));
+	scaleRampChannel(b, &base[2 * size], size, brt * tempMultiplier(temp_step, 2));
+}
+
+/**
+ * Linear resampling of a 3-channel ramp, for CRTCs and ICC tables
+ * whose size differs from ours.
+ */
+void resampleRamp(const uint16_t *src, int src_size, uint16_t *dst, int dst_size)
+{
+	for (int c = 0; c < 3; ++c) {
+
+		const uint16_t *s = &src[c * src_size];
+		uint16_t       *d = &dst[c * dst_size];
+
+		if (src_size < 2 || dst_size < 2) {
+			std::fill(d, d + dst_size, s[0]);
+			continue;
+		}
+
+		for (int i = 0; i < dst_size; ++i) {
+			const double x = double(i) * (src_size - 1) / (dst_size - 1);
+			const int    j = std::min(int(x), src_size - 2);
+			const double t = x - j;
+
+			d[i] = uint16_t(s[j] + t * (s[j + 1] - s[j]) + 0.5);
+		}
+	}
+}
+
+/**
+ * Tells whether a 3-channel ramp can be used as a calibration curve.
+ * It must not decrease, and must start near black and end near white:
+ * a ramp left dimmed or tinted by a previous run (ours or another tool's) is not one.
+ */
+bool rampSane(const uint16_t *ramp, int size)
+{
+	if (size < 2)
+		return false;
+
+	for (int c = 0; c < 3; ++c) {
+
+		const uint16_t *ch = &ramp[c * size];
+
+		if (ch[0] > UINT16_MAX / 5 || ch[size - 1] < UINT16_MAX / 5 * 4)
+			return false;
+
+		for (int i = 1; i < size; ++i) {
+			if (ch[i] < ch[i - 1])
+				return false;
+		}
+	}
+
+	return true;
+}
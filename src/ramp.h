@@ -0,0 +1,18 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef RAMP_H
+#define RAMP_H
+
+#include <cstdint>
+
+void fillRampChannel(uint16_t *out, int size, double gain);
+void fillGammaRamp(uint16_t *r, uint16_t *g, uint16_t *b, int size, int brt_step, int temp_step);
+void scaleRampChannel(uint16_t *out, const uint16_t *base, int size, double gain);
+void composeGammaRamp(uint16_t *r, uint16_t *g, uint16_t *b, const uint16_t *base, int size, int brt_step, int temp_step);
+void resampleRamp(const uint16_t *src, int src_size, uint16_t *dst, int dst_size);
+bool rampSane(const uint16_t *ramp, int size);
+
+#endif // RAMP_H
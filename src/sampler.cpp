@@ -0,0 +1,135 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <algorithm>
+#include "sampler.h"
+#include "luma.h"
+#include "cfg.h"
+#include "defs.h"
+
+static uint32_t hash(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
+
+/**
+ * Radical inverse of i with nested (Owen style) scrambling: each digit is
+ * shifted by an amount that depends on the digits before it. This keeps
+ * the stratification of the sequence, but the points no longer fall on
+ * multiples of size / base^k, which would line up with text lines and
+ * other patterns on common resolutions.
+ */
+static double scrambledRadicalInverse(uint32_t i, uint32_t base, uint32_t seed)
+{
+	const double inv    = 1. / base;
+	double       f      = inv;
+	double       r      = 0;
+	uint32_t     prefix = seed;
+
+	for (; f > 1e-9; f *= inv) {
+		const uint32_t d = i % base;
+		i /= base;
+
+		r     += f * ((d + hash(prefix)) % base);
+		prefix = hash(prefix ^ (d + 1) * 0x9e3779b9);
+	}
+
+	return r;
+}
+
+std::vector<SamplePoint> haltonPoints(int width, int height, int count, bool centered)
+{
+	std::vector<SamplePoint> pts(count);
+
+	const double cx = width / 2.,
+	             cy = height / 2.;
+
+	for (int i = 0; i < count; ++i) {
+		const int x = std::min(int(scrambledRadicalInverse(i, 2, 0x2545f491) * width), width - 1);
+		const int y = std::min(int(scrambledRadicalInverse(i, 3, 0x9e3779b9) * height), height - 1);
+
+		uint32_t w = 1;
+
+		// Same weights as the grid of sampleCentered()
+		if (centered) {
+			const double dx = (x - cx) / cx;
+			const double dy = (y - cy) / cy;
+			w = 1 + uint32_t(15 * std::max(0., 1 - dx * dx - dy * dy));
+		}
+
+		pts[i] = { x, y, w };
+	}
+
+	// Row by row, so memory is read forwards
+	std::sort(pts.begin(), pts.end(), [] (const SamplePoint &a, const SamplePoint &b) {
+		return a.y != b.y ? a.y < b.y : a.x < b.x;
+	});
+
+	return pts;
+}
+
+/* The points of the last image size. Captures happen on one thread per backend,
+ * and the size only changes with the screen or the active window. */
+namespace {
+struct PointCache {
+	int  width    = 0;
+	int  height   = 0;
+	int  count    = 0;
+	bool centered = false;
+	std::vector<SamplePoint> pts;
+};
+}
+
+static const std::vector<SamplePoint>& cachedPoints(int width, int height, int count, bool centered)
+{
+	thread_local PointCache c;
+
+	if (c.width != width || c.height != height || c.count != count || c.centered != centered) {
+		c.width    = width;
+		c.height   = height;
+		c.count    = count;
+		c.centered = centered;
+		c.pts      = haltonPoints(width, height, count, centered);
+
+		LOGV << "Sample points: " << count << " for " << width << '*' << height;
+	}
+
+	return c.pts;
+}
+
+void samplePixels(const PixelFormat &f, LumaHistogram &h, const uint8_t *buf, int width, int height, int bytes_per_line, int y_offset, int full_height)
+{
+	const bool centered = cfg["brt_region"].get<int>() == REGION_CENTER_WEIGHTED;
+	const int  budget   = cfg["brt_samples"];
+
+	if (width <= 0 || height <= 0)
+		return;
+
+	if (budget <= 0) {
+		if (centered)
+			f.sampleCentered(f, h, buf, width, height, bytes_per_line, 1024, y_offset, full_height);
+		else
+			f.sample(f, h, buf, uint64_t(bytes_per_line) * height, 1024);
+		return;
+	}
+
+	const int  count = int(std::min(int64_t(budget), int64_t(width) * full_height));
+	const auto &pts  = cachedPoints(width, full_height, count, centered);
+
+	// Only the points in this strip
+	const auto first = std::lower_bound(pts.begin(), pts.end(), y_offset, [] (const SamplePoint &p, int y) {
+		return p.y < y;
+	});
+	const auto last = std::lower_bound(first, pts.end(), y_offset + height, [] (const SamplePoint &p, int y) {
+		return p.y < y;
+	});
+
+	f.samplePoints(f, h, buf, bytes_per_line, pts.data() + (first - pts.begin()), uint64_t(last - first), y_offset);
+}
@@ -0,0 +1,30 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstdint>
+#include <vector>
+#include "pixfmt.h"
+
+struct LumaHistogram;
+
+/**
+ * Pixel positions of a scrambled Halton (2, 3) sequence over an image, sorted by row.
+ * Low discrepancy: they cover the image evenly without lining up
+ * with its rows or columns, unlike a fixed stride in memory.
+ * Weighted towards the center when centered is true.
+ */
+std::vector<SamplePoint> haltonPoints(int width, int height, int count, bool centered);
+
+/**
+ * Adds the samples of an image, or of a horizontal strip of it starting
+ * at row y_offset, to the histogram. Reads "brt_samples" pixels of the
+ * full image, or every 1024th one if it's 0.
+ */
+void samplePixels(const PixelFormat &f, LumaHistogram &h, const uint8_t *buf, int width, int height, int bytes_per_line, int y_offset, int full_height);
+
+#endif // SAMPLER_H
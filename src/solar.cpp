@@ -0,0 +1,222 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include "solar.h"
+#include "cfg.h"
+#include "defs.h"
+#include "utils.h"
+
+static tm localTime(time_t t)
+{
+	tm r;
+#ifdef _WIN32
+	localtime_s(&r, &t);
+#else
+	localtime_r(&t, &r);
+#endif
+	return r;
+}
+
+static tm utcTime(time_t t)
+{
+	tm r;
+#ifdef _WIN32
+	gmtime_s(&r, &t);
+#else
+	gmtime_r(&t, &r);
+#endif
+	return r;
+}
+
+/**
+ * Elevation of the sun above the horizon in degrees, from the NOAA
+ * "General Solar Position Calculations". Accurate to a few arc minutes,
+ * which is plenty for scheduling.
+ */
+double solarElevation(time_t t, double lat, double lon)
+{
+	constexpr double pi  = 3.14159265358979323846;
+	constexpr double rad = pi / 180;
+
+	const tm u = utcTime(t);
+
+	const double hour   = u.tm_hour + u.tm_min / 60. + u.tm_sec / 3600.;
+	const double g      = 2 * pi / 365 * (u.tm_yday + (hour - 12) / 24);
+
+	const double eqtime = 229.18 * (0.000075 + 0.001868 * std::cos(g) - 0.032077 * std::sin(g)
+	                      - 0.014615 * std::cos(2 * g) - 0.040849 * std::sin(2 * g));
+
+	const double decl   = 0.006918 - 0.399912 * std::cos(g) + 0.070257 * std::sin(g)
+	                      - 0.006758 * std::cos(2 * g) + 0.000907 * std::sin(2 * g)
+	                      - 0.002697 * std::cos(3 * g) + 0.00148 * std::sin(3 * g);
+
+	const double solar_min = hour * 60 + eqtime + 4 * lon;
+	const double ha        = (solar_min / 4 - 180) * rad;
+
+	const double cos_zenith = std::sin(lat * rad) * std::sin(decl) + std::cos(lat * rad) * std::cos(decl) * std::cos(ha);
+
+	return 90 - std::acos(std::clamp(cos_zenith, -1., 1.)) / rad;
+}
+
+double TempCurve::secondOfDay(time_t t)
+{
+	const tm now = localTime(t);
+
+	if (now.tm_year != year || now.tm_yday != yday)
+		build(now);
+
+	return now.tm_hour * 3600 + now.tm_min * 60 + now.tm_sec;
+}
+
+int TempCurve::kelvinAt(time_t t)
+{
+	return int(timeline.target(secondOfDay(t)));
+}
+
+bool TempCurve::changing(time_t t)
+{
+	return timeline.changing(secondOfDay(t));
+}
+
+time_t TempCurve::nextChange(time_t t)
+{
+	const double sec = secondOfDay(t);
+	return t + time_t(timeline.nextChange(sec) - sec);
+}
+
+/**
+ * First second at which the temperature is out of the range between k1 and k2.
+ */
+time_t TempCurve::leaveTime(double k1, double k2, time_t t)
+{
+	const double sec = secondOfDay(t);
+	return t + time_t(std::ceil(timeline.leaveTime(std::min(k1, k2), std::max(k1, k2), sec) - sec));
+}
+
+void TempCurve::invalidate()
+{
+	year = -1;
+}
+
+void TempCurve::build(const tm &day)
+{
+	year = day.tm_year;
+	yday = day.tm_yday;
+
+	std::vector<Keyframe> k;
+
+	switch (cfg["temp_schedule"].get<int>()) {
+	case SCHEDULE_SOLAR:
+		buildSolar(day, k);
+		break;
+	case SCHEDULE_KEYFRAMES:
+		buildKeyframes(k);
+		break;
+	default:
+		break;
+	}
+
+	// Also the fallback for an empty keyframe list
+	if (k.empty())
+		buildFixed(k);
+
+	LOGD << "Temperature timeline built for day " << yday + 1 << ": " << k.size() << " keyframes";
+
+	timeline.compile(std::move(k));
+}
+
+static double toSeconds(const std::string &s)
+{
+	const int h   = std::stoi(s.substr(0, 2));
+	const int m   = std::stoi(s.substr(3, 2));
+	const int sec = s.size() >= 8 ? std::stoi(s.substr(6, 2)) : 0;
+	return h * 3600 + m * 60 + sec;
+}
+
+/**
+ * The transition to temp_low starts "temp_speed" minutes before "temp_sunset"
+ * and temp_high is restored at "temp_sunrise".
+ */
+void TempCurve::buildFixed(std::vector<Keyframe> &k)
+{
+	const int    high    = cfg["temp_high"];
+	const int    low     = cfg["temp_low"];
+	const double sunset  = toSeconds(cfg["temp_sunset"]);
+	const double speed   = std::max(cfg["temp_speed"].get<double>(), 0.) * 60;
+
+	k.push_back({ sunset - speed, high, EASE_STEP });
+	k.push_back({ sunset, low, EASE_LINEAR });
+	k.push_back({ toSeconds(cfg["temp_sunrise"]), high, EASE_STEP });
+}
+
+/**
+ * temp_high while the sun is up, temp_low once it's 6° below the horizon
+ * (end of civil twilight), linear in between. The elevation is sampled
+ * each minute, and keyframes are placed where the curve enters or leaves
+ * the limits, and on its peaks in between. Polar days and nights need no
+ * special casing: the sun just never crosses the thresholds.
+ * Each wall clock minute is converted with mktime, so on DST change days
+ * the skipped hour maps to the following one.
+ */
+void TempCurve::buildSolar(const tm &day, std::vector<Keyframe> &k)
+{
+	constexpr double sunset_elev   = -0.833; // Refraction and solar disc radius
+	constexpr double twilight_elev = -6;
+	constexpr int    minutes       = 24 * 60;
+
+	const int    high = cfg["temp_high"];
+	const int    low  = cfg["temp_low"];
+	const double lat  = std::clamp(cfg["temp_lat"].get<double>(), -90., 90.);
+	const double lon  = std::clamp(cfg["temp_lon"].get<double>(), -180., 180.);
+
+	std::vector<double> x(minutes);
+
+	for (int m = 0; m < minutes; ++m) {
+		tm wall {};
+		wall.tm_year  = day.tm_year;
+		wall.tm_mon   = day.tm_mon;
+		wall.tm_mday  = day.tm_mday;
+		wall.tm_hour  = m / 60;
+		wall.tm_min   = m % 60;
+		wall.tm_isdst = -1;
+
+		const double elev = solarElevation(mktime(&wall), lat, lon);
+		x[m] = std::clamp(normalize(elev, twilight_elev, sunset_elev), 0., 1.);
+	}
+
+	const auto add = [&] (int m) {
+		k.push_back({ m * 60., int(lerp(x[m], low, high)), EASE_LINEAR });
+	};
+
+	add(0);
+
+	for (int m = 1; m < minutes - 1; ++m) {
+		const bool lim      = x[m] == 0 || x[m] == 1;
+		const bool prev_lim = x[m - 1] == 0 || x[m - 1] == 1;
+		const bool next_lim = x[m + 1] == 0 || x[m + 1] == 1;
+		const bool peak     = (x[m] > x[m - 1] && x[m] >= x[m + 1]) || (x[m] < x[m - 1] && x[m] <= x[m + 1]);
+
+		if ((lim && !next_lim) || (lim && !prev_lim) || (!lim && peak))
+			add(m);
+	}
+
+	add(minutes - 1);
+}
+
+void TempCurve::buildKeyframes(std::vector<Keyframe> &k)
+{
+	for (const auto &j : cfg["temp_keyframes"]) {
+		try {
+			k.push_back({ toSeconds(j["time"]), j["temp"], j.value("easing", int(EASE_LINEAR)) });
+		} catch (const std::exception &e) {
+			LOGE << "Invalid temperature keyframe: " << j.dump() << " (" << e.what() << ')';
+		}
+	}
+
+	LOGE_IF(k.empty()) << "No valid temperature keyframes. Using the fixed schedule.";
+}
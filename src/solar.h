@@ -0,0 +1,50 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef SOLAR_H
+#define SOLAR_H
+
+#include <ctime>
+#include <vector>
+#include "timeline.h"
+
+/**
+ * How the day's temperature curve is built. Stored in the config as "temp_schedule".
+ */
+enum TempScheduleMode {
+	SCHEDULE_FIXED, // "temp_sunset" - "temp_speed" to "temp_sunrise"
+	SCHEDULE_SOLAR, // From the sun's elevation at "temp_lat", "temp_lon"
+	SCHEDULE_KEYFRAMES, // "temp_keyframes": [{ "time": "HH:MM", "temp": K, "easing": Easing }, ...]
+	SCHEDULE_COUNT
+};
+
+double solarElevation(time_t t, double lat, double lon);
+
+/**
+ * The temperature schedule of the local day, as a timeline of keyframes.
+ * Rebuilt once per day, or after invalidate().
+ * Keyframes are in wall clock time, so they follow DST changes.
+ */
+class TempCurve
+{
+public:
+	int    kelvinAt(time_t t);
+	bool   changing(time_t t);
+	time_t nextChange(time_t t);
+	time_t leaveTime(double k1, double k2, time_t t);
+	void   invalidate();
+private:
+	Timeline timeline;
+	int year = -1;
+	int yday = -1;
+
+	double secondOfDay(time_t t);
+	void   build(const tm &day);
+	void   buildFixed(std::vector<Keyframe> &k);
+	void   buildSolar(const tm &day, std::vector<Keyframe> &k);
+	void   buildKeyframes(std::vector<Keyframe> &k);
+};
+
+#endif // SOLAR_H
@@ -0,0 +1,130 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "timeline.h"
+#include "utils.h"
+
+static double wrap(double t)
+{
+	t = std::fmod(t, Timeline::day);
+	return t < 0 ? t + Timeline::day : t;
+}
+
+/**
+ * Keyframes can be in any order. With equal times, the last one wins.
+ */
+void Timeline::compile(std::vector<Keyframe> keyframes)
+{
+	for (auto &k : keyframes)
+		k.time = wrap(k.time);
+
+	std::stable_sort(keyframes.begin(), keyframes.end(), [] (const Keyframe &a, const Keyframe &b) {
+		return a.time < b.time;
+	});
+
+	keys.clear();
+
+	for (const auto &k : keyframes) {
+		if (!keys.empty() && keys.back().time == k.time)
+			keys.back() = k;
+		else
+			keys.push_back(k);
+	}
+}
+
+bool Timeline::empty() const
+{
+	return keys.empty();
+}
+
+Timeline::Segment Timeline::segmentAt(double t) const
+{
+	const auto it = std::upper_bound(keys.begin(), keys.end(), t, [] (double t, const Keyframe &k) {
+		return t < k.time;
+	});
+
+	Keyframe from = it == keys.begin() ? keys.back() : *(it - 1);
+	Keyframe to   = it == keys.end()   ? keys.front() : *it;
+
+	if (it == keys.begin())
+		from.time -= day;
+
+	if (it == keys.end())
+		to.time += day;
+
+	return { from, to };
+}
+
+double Timeline::target(double t) const
+{
+	if (keys.empty())
+		return 0;
+
+	t = wrap(t);
+
+	const Segment s = segmentAt(t);
+
+	if (!changing(t))
+		return s.from.kelvin;
+
+	const double x = (t - s.from.time) / (s.to.time - s.from.time);
+
+	return lerp(ease(s.to.easing, x), s.from.kelvin, s.to.kelvin);
+}
+
+bool Timeline::changing(double t) const
+{
+	if (keys.size() < 2)
+		return false;
+
+	const Segment s = segmentAt(wrap(t));
+
+	return s.from.kelvin != s.to.kelvin && s.to.easing != EASE_STEP;
+}
+
+/**
+ * Start of the next transition (t itself if one is under way),
+ * on the same clock as t. A day later if nothing ever changes.
+ */
+double Timeline::nextChange(double t) const
+{
+	if (keys.size() < 2)
+		return t + day;
+
+	if (changing(t))
+		return t;
+
+	const double base = t - wrap(t);
+	const Segment s   = segmentAt(wrap(t));
+
+	return base + s.to.time;
+}
+
+/**
+ * When the target leaves the range [lo, hi] while in the transition
+ * under way at t, through the inverse of its easing. If it stays in
+ * the range, the end of the transition. If nothing is changing,
+ * the start of the next transition.
+ */
+double Timeline::leaveTime(double lo, double hi, double t) const
+{
+	if (!changing(t))
+		return nextChange(t);
+
+	const double base = t - wrap(t);
+	const Segment s   = segmentAt(wrap(t));
+	const double to   = s.to.kelvin;
+
+	if (to >= lo && to <= hi)
+		return base + s.to.time;
+
+	const double bound = to > hi ? hi : lo;
+	const double y     = (bound - s.from.kelvin) / (to - s.from.kelvin);
+	const double x     = easeInverse(s.to.easing, y);
+
+	return base + s.from.time + x * (s.to.time - s.from.time);
+}
@@ -0,0 +1,44 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <vector>
+#include "easing.h"
+
+struct Keyframe {
+	double time;   // Seconds since midnight
+	int    kelvin;
+	int    easing; // Of the transition that ends on this keyframe
+};
+
+/**
+ * A day long, wrapping sequence of keyframes.
+ * Compiled (sorted) once, then queried with binary searches.
+ */
+class Timeline
+{
+public:
+	static constexpr double day = 24 * 60 * 60;
+
+	void   compile(std::vector<Keyframe> keyframes);
+	bool   empty() const;
+	double target(double t) const;
+	bool   changing(double t) const;
+	double nextChange(double t) const;
+	double leaveTime(double lo, double hi, double t) const;
+private:
+	std::vector<Keyframe> keys;
+
+	struct Segment {
+		Keyframe from;
+		Keyframe to; // Its time can be past 'day' when wrapping
+	};
+
+	Segment segmentAt(double t) const;
+};
+
+#endif // TIMELINE_H
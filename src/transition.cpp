@@ -0,0 +1,127 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "transition.h"
+
+/* omega * duration for which a spring starting at rest has covered
+ * all but 2^-10 of the distance, like easeOutExpo at its end. */
+static constexpr double settle = 9.23;
+
+Spring::Spring(double pos, double duration)
+{
+	omega = settle / std::max(duration, 1e-3);
+	reset(pos, 0);
+}
+
+/**
+ * At rest at pos, with pos as the target.
+ */
+void Spring::reset(double pos, double t)
+{
+	t0   = t;
+	dest = int(std::lround(pos));
+	c1   = pos - dest;
+	c2   = omega * c1;
+}
+
+/**
+ * Position and velocity at t are kept, only the target changes.
+ */
+void Spring::retarget(int target, double t, double duration)
+{
+	const double x = position(t);
+	const double v = velocity(t);
+
+	omega = settle / std::max(duration, 1e-3);
+	t0    = t;
+	dest  = target;
+	c1    = x - target;
+	c2    = v + omega * c1;
+}
+
+double Spring::position(double t) const
+{
+	const double dt = std::max(t - t0, 0.);
+	return dest + (c1 + c2 * dt) * std::exp(-omega * dt);
+}
+
+double Spring::velocity(double t) const
+{
+	const double dt = std::max(t - t0, 0.);
+	return (c2 - omega * (c1 + c2 * dt)) * std::exp(-omega * dt);
+}
+
+int Spring::stepAt(double t) const
+{
+	return int(std::lround(position(t)));
+}
+
+/**
+ * First time in [a, b] at which the step is no longer 'step'.
+ * The position must be monotonic in the interval, and the step
+ * must have changed at b.
+ */
+double Spring::crossing(int step, double a, double b) const
+{
+	for (int i = 0; i < 64 && b - a > 1e-7; ++i) {
+		const double m = (a + b) / 2;
+
+		if (stepAt(m) == step)
+			a = m;
+		else
+			b = m;
+	}
+
+	return b;
+}
+
+/**
+ * Time after t at which stepAt() next returns a different value,
+ * infinity if it never does.
+ * The position has at most one extremum (an overshoot when the velocity
+ * points at the target, a turn when it points away from it). On each
+ * monotonic piece, the step change is found by bisection.
+ */
+double Spring::nextStepTime(double t) const
+{
+	constexpr double never = std::numeric_limits<double>::infinity();
+
+	const int cur = stepAt(t);
+
+	// Extremum, where the velocity is 0
+	if (c2 != 0) {
+		const double ext = t0 + 1 / omega - c1 / c2;
+
+		if (ext > t) {
+			if (stepAt(ext) != cur)
+				return crossing(cur, t, ext);
+			t = ext;
+		}
+	}
+
+	// Then it only moves towards the target
+	if (dest == cur)
+		return never;
+
+	double b = t + 1 / omega;
+
+	while (stepAt(b) == cur)
+		b += b - t;
+
+	return crossing(cur, t, b);
+}
+
+bool Spring::done(double t) const
+{
+	return std::isinf(nextStepTime(t));
+}
+
+int Spring::target() const
+{
+	return dest;
+}
@@ -0,0 +1,39 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef TRANSITION_H
+#define TRANSITION_H
+
+/**
+ * A critically damped spring moving a step towards its target, in seconds.
+ * The target can change at any time: the spring carries on from its current
+ * position and velocity, so the rate never jumps.
+ * Steps are rounded to the nearest integer. Instead of being sampled at
+ * a fixed frame rate, the spring tells when the rounded step changes next,
+ * so its users can sleep until then.
+ */
+class Spring
+{
+public:
+	Spring(double pos, double duration);
+	void   reset(double pos, double t);
+	void   retarget(int target, double t, double duration);
+	double position(double t) const;
+	double velocity(double t) const;
+	int    stepAt(double t) const;
+	double nextStepTime(double t) const;
+	bool   done(double t) const;
+	int    target() const;
+private:
+	double t0    = 0;
+	double c1    = 0; // Offset from the target at t0
+	double c2    = 0; // c1 * omega + velocity at t0
+	double omega = 1;
+	int    dest  = 0;
+
+	double crossing(int step, double a, double b) const;
+};
+
+#endif // TRANSITION_H
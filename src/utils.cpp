@@ -7,19 +7,49 @@
 #include <Windows.h>
 #endif
 
+#include <algorithm>
 #include "utils.h"
 #include "cfg.h"
 #include "defs.h"
+#include "luma.h"
+#include "pixfmt.h"
+#include "sampler.h"
 
-int calcBrightness(uint8_t *buf, uint64_t buf_sz, int bytes_per_pixel, int stride)
+/**
+ * Samples the image, building a luma histogram in the same pass.
+ * The histogram is then reduced with the metric selected in the config.
+ */
+int calcBrightness(const uint8_t *buf, int width, int height, int bytes_per_line)
 {
-	uint64_t rgb[3] {};
-	for (uint64_t i = 0, inc = stride * bytes_per_pixel; i < buf_sz; i += inc) {
-		rgb[0] += buf[i + 2];
-		rgb[1] += buf[i + 1];
-		rgb[2] += buf[i];
-	}
-	return (rgb[0] * 0.2126 + rgb[1] * 0.7152 + rgb[2] * 0.0722) * stride / (buf_sz / bytes_per_pixel);
+	// Windows captures are always BGRA
+	const PixelFormat f = pixelFormat(32, 0xff0000, 0xff00, 0xff, false);
+
+	LumaHistogram h;
+	samplePixels(f, h, buf, width, height, bytes_per_line, 0, height);
+	return brightnessMetric(h);
+}
+
+/* Confidence interval of the last brightness reduced on this thread.
+ * Like the sample points, it's per capture thread. */
+static thread_local double last_confidence = 0;
+
+int brightnessMetric(const LumaHistogram &h)
+{
+	last_confidence = h.confidence();
+
+	LOGV << "Luma mean: " << double(h.sum) / std::max(h.samples, uint64_t(1)) << " +- " << last_confidence << " (" << h.reads << " pixels)";
+
+	return lumaMetric(h, cfg["brt_metric"], cfg["brt_percentile"], cfg["brt_highlight_weight"]);
+}
+
+/**
+ * Half width of the 95% confidence interval of the last brightnessMetric()
+ * on this thread, in luma units. A difference smaller than this
+ * can be just sampling noise.
+ */
+double brightnessConfidence()
+{
+	return last_confidence;
 }
 
 double lerp(double x, double a, double b)
@@ -37,24 +67,6 @@ double remap(double x, double a, double b, double ay, double by)
 	return lerp(normalize(x, a, b), ay, by);
 }
 
-double interpTemp(int temp_step, size_t color_ch)
-{
-	return remap(temp_steps_max - temp_step, 0, temp_steps_max, ingo_thies_table[color_ch], 1);
-};
-
-double easeOutExpo(double t, double b , double c, double d)
-{
-	return (t == d) ? b + c : c * (-pow(2, -10 * t / d) + 1) + b;
-}
-
-double easeInOutQuad(double t, double b, double c, double d)
-{
-	if ((t /= d / 2) < 1)
-		return c / 2 * t * t + b;
-	else
-		return -c / 2 * ((t - 1) * (t - 3) - 1) + b;
-};
-
 #ifdef _WIN32
 void checkGammaRange()
 {
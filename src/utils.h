@@ -9,13 +9,14 @@
 #include <cstddef>
 #include <cstdint>
 
-int    calcBrightness(uint8_t *buf, uint64_t buf_sz, int bytes_per_pixel, int stride);
+struct LumaHistogram;
+
+int    calcBrightness(const uint8_t *buf, int width, int height, int bytes_per_line);
+int    brightnessMetric(const LumaHistogram &h);
+double brightnessConfidence();
 double lerp(double x, double a, double b);
 double normalize(double x, double a, double b);
 double remap(double x, double a, double b, double ay, double by);
-double interpTemp(int step, size_t color_ch);
-double easeOutExpo(double t, double b , double c, double d);
-double easeInOutQuad(double t, double b, double c, double d);
 
 bool alreadyRunning();
 
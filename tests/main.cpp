@@ -0,0 +1,43 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <cstring>
+#include "test.h"
+
+namespace test {
+
+int failures = 0;
+
+std::vector<Case>& cases()
+{
+	static std::vector<Case> v;
+	return v;
+}
+
+} // namespace test
+
+/**
+ * Runs every case, or only the ones whose name contains argv[1].
+ * Returns non-zero if any check failed.
+ */
+int main(int argc, char **argv)
+{
+	int ran = 0;
+
+	for (const auto &c : test::cases()) {
+		if (argc > 1 && !std::strstr(c.name, argv[1]))
+			continue;
+
+		const int before = test::failures;
+		c.fn();
+		++ran;
+
+		std::printf("%-40s %s\n", c.name, test::failures == before ? "ok" : "FAILED");
+	}
+
+	std::printf("%d cases, %d failed checks\n", ran, test::failures);
+
+	return test::failures != 0;
+}
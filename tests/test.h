@@ -0,0 +1,59 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+/**
+ * Minimal test runner for the parts of Gammy that don't need Qt or a display.
+ * TEST() registers a case, CHECK() reports a failure and carries on,
+ * so a single run lists everything that's broken.
+ */
+namespace test {
+
+struct Case
+{
+	const char *name;
+	void (*fn)();
+};
+
+std::vector<Case>& cases();
+
+extern int failures;
+
+struct Register
+{
+	Register(const char *name, void (*fn)()) { cases().push_back({ name, fn }); }
+};
+
+} // namespace test
+
+#define TEST(name) \
+	static void name(); \
+	static const test::Register name##_registered(#name, name); \
+	static void name()
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			++test::failures; \
+			std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(a, b, tol) \
+	do { \
+		const double a_ = (a), b_ = (b); \
+		if (!(std::abs(a_ - b_) <= (tol))) { \
+			++test::failures; \
+			std::fprintf(stderr, "%s:%d: CHECK_NEAR(%s, %s, %s) failed: %g vs %g\n", __FILE__, __LINE__, #a, #b, #tol, a_, b_); \
+		} \
+	} while (0)
+
+#endif // TEST_H
@@ -0,0 +1,112 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <cmath>
+#include <vector>
+#include "test.h"
+#include "ramp.h"
+#include "defs.h"
+
+namespace {
+
+// A calibration curve like the ones colord loads: a different gamma and white point per channel
+std::vector<uint16_t> calibration(int size)
+{
+	std::vector<uint16_t> v(3 * size);
+
+	for (int c = 0; c < 3; ++c) {
+		for (int i = 0; i < size; ++i) {
+			const double x = double(i) / (size - 1);
+			v[c * size + i] = uint16_t(std::pow(x, 1.1 + 0.05 * c) * (UINT16_MAX - 300 * c) + 0.5);
+		}
+	}
+
+	return v;
+}
+
+} // namespace
+
+/**
+ * At full brightness and 6500K the composed ramp is the calibration itself.
+ */
+TEST(calibration_neutral_round_trip)
+{
+	for (int sz : { 256, 1024, 1025, 2048, 4096 }) {
+		const std::vector<uint16_t> base = calibration(sz);
+		std::vector<uint16_t> out(3 * sz);
+
+		composeGammaRamp(&out[0], &out[sz], &out[2 * sz], base.data(), sz, brt_steps_max, 0);
+
+		CHECK(out == base);
+	}
+}
+
+TEST(calibration_scaled_by_brightness)
+{
+	const int sz = 1024;
+	const std::vector<uint16_t> base = calibration(sz);
+	std::vector<uint16_t> out(3 * sz);
+
+	composeGammaRamp(&out[0], &out[sz], &out[2 * sz], base.data(), sz, brt_steps_max / 2, 0);
+
+	for (int i = 0; i < 3 * sz; ++i)
+		CHECK_NEAR(out[i], base[i] * 0.5, 0.5);
+}
+
+TEST(calibration_sanity)
+{
+	const int sz = 256;
+	std::vector<uint16_t> base = calibration(sz);
+
+	CHECK(rampSane(base.data(), sz));
+
+	// Left dimmed by a previous run
+	std::vector<uint16_t> dimmed = base;
+	for (auto &v : dimmed)
+		v /= 2;
+	CHECK(!rampSane(dimmed.data(), sz));
+
+	// Decreasing somewhere in the blue channel
+	std::vector<uint16_t> bumpy = base;
+	bumpy[2 * sz + 100] = bumpy[2 * sz + 99] - 1;
+	CHECK(!rampSane(bumpy.data(), sz));
+
+	CHECK(!rampSane(base.data(), 1));
+}
+
+/**
+ * CRTCs of a different size get the calibration resampled:
+ * same size is a copy, and the endpoints are kept at any size.
+ */
+TEST(calibration_resample)
+{
+	const int sz = 256;
+	const std::vector<uint16_t> base = calibration(sz);
+
+	std::vector<uint16_t> same(3 * sz);
+	resampleRamp(base.data(), sz, same.data(), sz);
+	CHECK(same == base);
+
+	for (int dst_sz : { 1024, 1025, 4096 }) {
+		std::vector<uint16_t> dst(3 * dst_sz);
+		resampleRamp(base.data(), sz, dst.data(), dst_sz);
+
+		CHECK(rampSane(dst.data(), dst_sz));
+
+		for (int c = 0; c < 3; ++c) {
+			CHECK(dst[c * dst_sz] == base[c * sz]);
+			CHECK(dst[c * dst_sz + dst_sz - 1] == base[c * sz + sz - 1]);
+		}
+
+		// Back to the original size, through the composed neutral ramp.
+		// The curve is smooth, so linear interpolation loses at most one unit.
+		std::vector<uint16_t> composed(3 * dst_sz), back(3 * sz);
+		composeGammaRamp(&composed[0], &composed[dst_sz], &composed[2 * dst_sz], dst.data(), dst_sz, brt_steps_max, 0);
+		resampleRamp(composed.data(), dst_sz, back.data(), sz);
+
+		for (int i = 0; i < 3 * sz; ++i)
+			CHECK_NEAR(back[i], base[i], 1);
+	}
+}
@@ -0,0 +1,81 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <algorithm>
+#include "test.h"
+#include "colortemp.h"
+#include "defs.h"
+
+namespace {
+
+constexpr int rows = int(ingo_thies_table.size() / 3);
+
+// Linear interpolation of the reference table at any temperature
+double reference(double kelvin, int c)
+{
+	const double row = (kelvin - temp_k_max) / 100;
+	const int    i   = std::min(int(row), rows - 2);
+	const double x   = row - i;
+
+	return ingo_thies_table[i * 3 + c] * (1 - x) + ingo_thies_table[(i + 1) * 3 + c] * x;
+}
+
+} // namespace
+
+TEST(colortemp_matches_reference)
+{
+	double max_err = 0;
+
+	for (int s = 0; s <= temp_steps_max; ++s) {
+		for (int c = 0; c < 3; ++c)
+			max_err = std::max(max_err, std::abs(tempMultiplier(s, c) - reference(stepToKelvin(s), c)));
+	}
+
+	CHECK(max_err < 1e-9);
+}
+
+/**
+ * The whole table is used, not just its ends: a step between two rows
+ * stays between their values.
+ */
+TEST(colortemp_between_rows)
+{
+	for (int s = 0; s <= temp_steps_max; ++s) {
+
+		const double row = (stepToKelvin(s) - temp_k_max) / 100;
+		const int    i   = std::min(int(row), rows - 2);
+
+		for (int c = 0; c < 3; ++c) {
+			const double a = ingo_thies_table[i * 3 + c];
+			const double b = ingo_thies_table[(i + 1) * 3 + c];
+
+			CHECK(tempMultiplier(s, c) >= std::min(a, b) - 1e-12);
+			CHECK(tempMultiplier(s, c) <= std::max(a, b) + 1e-12);
+		}
+	}
+}
+
+TEST(colortemp_warmer_with_each_step)
+{
+	for (int s = 1; s <= temp_steps_max; ++s) {
+		CHECK(tempMultiplier(s, 0) == 1);
+		CHECK(tempMultiplier(s, 1) <= tempMultiplier(s - 1, 1));
+		CHECK(tempMultiplier(s, 2) <= tempMultiplier(s - 1, 2));
+	}
+}
+
+TEST(colortemp_endpoints_and_clamping)
+{
+	for (int c = 0; c < 3; ++c) {
+		CHECK(tempMultiplier(0, c) == 1);
+		CHECK(tempMultiplier(temp_steps_max, c) == ingo_thies_table[c]);
+
+		CHECK(tempMultiplier(-10, c) == tempMultiplier(0, c));
+		CHECK(tempMultiplier(temp_steps_max + 10, c) == tempMultiplier(temp_steps_max, c));
+	}
+
+	CHECK(stepToKelvin(0) == temp_k_min);
+	CHECK(stepToKelvin(temp_steps_max) == temp_k_max);
+}
@@ -0,0 +1,63 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include "test.h"
+#include "easing.h"
+
+/**
+ * Where the curve is continuous, the inverse lands exactly on y.
+ * Where it jumps (step, the tail of easeOutExpo), it lands on the jump:
+ * at or past y, and nothing earlier reaches it.
+ */
+TEST(easing_inverse_round_trip)
+{
+	for (int e = 0; e < EASE_COUNT; ++e) {
+		for (int i = 1; i < 1000; ++i) {
+			const double y = i / 1000.;
+			const double x = easeInverse(e, y);
+
+			CHECK(x >= 0 && x <= 1);
+
+			if (x < 1)
+				CHECK_NEAR(ease(e, x), y, 1e-12);
+			else
+				CHECK(ease(e, x) >= y);
+
+			CHECK(ease(e, x - 1e-9) < y);
+		}
+	}
+}
+
+TEST(easing_inverse_of_ease)
+{
+	for (int e : { EASE_LINEAR, EASE_IN_OUT_QUAD, EASE_OUT_EXPO }) {
+		for (int i = 0; i < 1000; ++i) {
+			const double x = i / 1000.;
+			CHECK_NEAR(easeInverse(e, ease(e, x)), x, 1e-9);
+		}
+	}
+}
+
+/**
+ * Before the start and past the end, the curves are flat,
+ * and the inverse is clamped to the ends.
+ */
+TEST(easing_flat_ends)
+{
+	for (int e = 0; e < EASE_COUNT; ++e) {
+		CHECK(ease(e, 0) == 0);
+		CHECK(ease(e, 1) == 1);
+		CHECK(ease(e, -0.5) == 0);
+		CHECK(ease(e, 1.5) == 1);
+
+		CHECK(easeInverse(e, 0) == 0);
+		CHECK(easeInverse(e, -0.5) == 0);
+		CHECK(easeInverse(e, 1) == 1);
+		CHECK(easeInverse(e, 1.5) == 1);
+
+		CHECK(ease(e, easeInverse(e, 0)) == 0);
+		CHECK(ease(e, easeInverse(e, 1)) == 1);
+	}
+}
@@ -0,0 +1,114 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include "test.h"
+#include "luma.h"
+
+namespace {
+
+// A dark IDE with a bright browser tab: 70% at 30, 30% at 230
+LumaHistogram ide()
+{
+	LumaHistogram h;
+	h.add(30, 70);
+	h.add(230, 30);
+	return h;
+}
+
+} // namespace
+
+TEST(luma_mean)
+{
+	LumaHistogram h;
+	CHECK(h.mean() == 0);
+
+	for (int i = 0; i < 256; ++i)
+		h.add(i);
+
+	CHECK(h.samples == 256);
+	CHECK(h.reads == 256);
+	CHECK(h.mean() == 127);
+
+	// Weights count as that many samples, but as a single read
+	const LumaHistogram w = ide();
+	CHECK(w.samples == 100);
+	CHECK(w.reads == 2);
+	CHECK(w.mean() == 90);
+}
+
+/**
+ * The smallest value below which at least p percent of the samples fall.
+ */
+TEST(luma_percentile)
+{
+	const LumaHistogram h = ide();
+
+	CHECK(h.percentile(0) == 30);
+	CHECK(h.percentile(50) == 30);
+	CHECK(h.percentile(70) == 30);
+	CHECK(h.percentile(70.1) == 230);
+	CHECK(h.percentile(100) == 230);
+
+	// Out of range is clamped
+	CHECK(h.percentile(-10) == 30);
+	CHECK(h.percentile(150) == 230);
+
+	LumaHistogram ramp;
+	for (int i = 0; i < 100; ++i)
+		ramp.add(i);
+
+	CHECK(ramp.percentile(1) == 0);
+	CHECK(ramp.percentile(50) == 49);
+	CHECK(ramp.percentile(95) == 94);
+
+	CHECK(LumaHistogram().percentile(50) == 0);
+}
+
+/**
+ * Highlights pull the APL up from the mean, more so with a higher weight.
+ */
+TEST(luma_apl)
+{
+	const LumaHistogram h = ide();
+
+	CHECK(h.apl(0) == h.mean());
+	CHECK(h.apl(1) > h.mean());
+	CHECK(h.apl(4) > h.apl(1));
+	CHECK(h.apl(4) <= 230);
+
+	// A uniform image has no highlights to weigh
+	LumaHistogram flat;
+	flat.add(128, 1000);
+	CHECK(flat.apl(4) == 128);
+}
+
+TEST(luma_metrics)
+{
+	const LumaHistogram h = ide();
+
+	CHECK(lumaMetric(h, LUMA_MEAN, 90, 2) == h.mean());
+	CHECK(lumaMetric(h, LUMA_MEDIAN, 90, 2) == 30);
+	CHECK(lumaMetric(h, LUMA_PERCENTILE, 90, 2) == 230);
+	CHECK(lumaMetric(h, LUMA_APL, 90, 2) == h.apl(2));
+}
+
+TEST(luma_merge)
+{
+	LumaHistogram a, b;
+	a.add(30, 70);
+	b.add(230, 30);
+	a.merge(b);
+
+	const LumaHistogram h = ide();
+
+	CHECK(a.count == h.count);
+	CHECK(a.sum == h.sum);
+	CHECK(a.samples == h.samples);
+	CHECK(a.reads == h.reads);
+
+	a.clear();
+	CHECK(a.samples == 0);
+	CHECK(a.mean() == 0);
+}
@@ -0,0 +1,195 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <string>
+#include <vector>
+#include "test.h"
+#include "pixfmt.h"
+#include "luma.h"
+
+namespace {
+
+struct Format
+{
+	int      bpp;
+	uint32_t masks[3]; // R, G, B
+	bool     specialized;
+};
+
+const Format formats[] {
+	{ 32, { 0xff0000,   0xff00,    0xff       }, true  },
+	{ 32, { 0xff,       0xff00,    0xff0000   }, true  },
+	{ 32, { 0xff000000, 0xff0000,  0xff00     }, true  },
+	{ 24, { 0xff0000,   0xff00,    0xff       }, true  },
+	{ 24, { 0xff,       0xff00,    0xff0000   }, true  },
+	{ 32, { 0x3ff00000, 0xffc00,   0x3ff      }, true  }, // X2RGB10
+	{ 32, { 0x3ff,      0xffc00,   0x3ff00000 }, true  }, // X2BGR10
+	{ 16, { 0xf800,     0x7e0,     0x1f       }, true  }, // RGB565
+	{ 16, { 0x1f,       0x7e0,     0xf800     }, true  }, // BGR565
+	{ 16, { 0x7c00,     0x3e0,     0x1f       }, true  }, // XRGB1555
+	{ 32, { 0x7ff00000, 0xffc00,   0x3ff      }, false }, // 11 bits of red
+	{ 16, { 0xf00,      0xf0,      0xf        }, false }, // RGB444
+};
+
+const int colors[][3] {
+	{ 0,    0,    0    },
+	{ 255,  255,  255  },
+	{ 255,  0,    0    },
+	{ 0,    255,  0    },
+	{ 0,    0,    255  },
+	{ 0x12, 0x9a, 0xfe },
+	{ 200,  100,  50   },
+};
+
+int lowestBit(uint32_t m)
+{
+	int i = 0;
+	for (; m && !(m & 1); m >>= 1)
+		++i;
+	return i;
+}
+
+int countBits(uint32_t m)
+{
+	int n = 0;
+	for (; m; m &= m - 1)
+		++n;
+	return n;
+}
+
+// 8-bit channel to n bits: truncated, or widened by replicating the high bits
+uint32_t fromByte(int c, int bits)
+{
+	if (bits <= 8)
+		return uint32_t(c) >> (8 - bits);
+
+	return (uint32_t(c) << (bits - 8)) | (uint32_t(c) >> (16 - bits));
+}
+
+uint32_t encode(const Format &f, const int rgb[3])
+{
+	uint32_t v = 0;
+
+	for (int i = 0; i < 3; ++i)
+		v |= fromByte(rgb[i], countBits(f.masks[i])) << lowestBit(f.masks[i]);
+
+	return v;
+}
+
+// Luma of the stored value, with channels scaled exactly to 8 bits
+int referenceLuma(const Format &f, uint32_t v)
+{
+	int c[3];
+
+	for (int i = 0; i < 3; ++i) {
+		const uint32_t max = (1u << countBits(f.masks[i])) - 1;
+		c[i] = int(std::lround(((v >> lowestBit(f.masks[i])) & max) * 255. / max));
+	}
+
+	return luma709(c[0], c[1], c[2]);
+}
+
+void store(uint8_t *p, int bytes, bool msb_first, uint32_t v)
+{
+	for (int i = 0; i < bytes; ++i)
+		p[msb_first ? bytes - 1 - i : i] = uint8_t(v >> (8 * i));
+}
+
+} // namespace
+
+/**
+ * Every format, in both byte orders, decodes to the luma of the stored value.
+ */
+TEST(pixfmt_decodes_every_format)
+{
+	for (const auto &fmt : formats) {
+		for (bool msb : { false, true }) {
+			const PixelFormat f = pixelFormat(fmt.bpp, fmt.masks[0], fmt.masks[1], fmt.masks[2], msb);
+
+			CHECK(f.bytes_per_pixel == fmt.bpp / 8);
+			CHECK(fmt.specialized == (std::string(f.name).find("generic") == std::string::npos));
+
+			for (const auto &rgb : colors) {
+				const uint32_t v = encode(fmt, rgb);
+
+				uint8_t px[4] {};
+				store(px, f.bytes_per_pixel, msb, v);
+
+				LumaHistogram h;
+				f.sample(f, h, px, f.bytes_per_pixel, 1);
+
+				CHECK(h.samples == 1);
+				CHECK_NEAR(h.mean(), referenceLuma(fmt, v), 1);
+			}
+		}
+	}
+}
+
+TEST(pixfmt_black_and_white_are_exact)
+{
+	const int black[3] { 0, 0, 0 };
+	const int white[3] { 255, 255, 255 };
+
+	for (const auto &fmt : formats) {
+		for (bool msb : { false, true }) {
+			const PixelFormat f = pixelFormat(fmt.bpp, fmt.masks[0], fmt.masks[1], fmt.masks[2], msb);
+
+			uint8_t px[8] {};
+			store(&px[0], f.bytes_per_pixel, msb, encode(fmt, black));
+			store(&px[f.bytes_per_pixel], f.bytes_per_pixel, msb, encode(fmt, white));
+
+			LumaHistogram h;
+			f.sample(f, h, px, 2 * f.bytes_per_pixel, 1);
+
+			CHECK(h.count[0] == 1);
+			CHECK(h.count[255] == 1);
+		}
+	}
+}
+
+/**
+ * The three kernels agree on a uniform image with padded lines,
+ * and the points kernel honors the strip offset.
+ */
+TEST(pixfmt_kernels_agree)
+{
+	const int w = 64, h = 48, pad = 12;
+	const int rgb[3] { 200, 100, 50 };
+
+	for (const auto &fmt : formats) {
+		for (bool msb : { false, true }) {
+			const PixelFormat f = pixelFormat(fmt.bpp, fmt.masks[0], fmt.masks[1], fmt.masks[2], msb);
+
+			const int bpp = f.bytes_per_pixel;
+			const int bpl = w * bpp + pad;
+
+			// Padding is garbage: reading it would change the result
+			std::vector<uint8_t> buf(size_t(bpl) * h, 0xff);
+
+			for (int y = 0; y < h; ++y)
+				for (int x = 0; x < w; ++x)
+					store(&buf[size_t(y) * bpl + x * bpp], bpp, msb, encode(fmt, rgb));
+
+			LumaHistogram one;
+			f.sample(f, one, buf.data(), bpp, 1);
+			const int expected = one.mean();
+
+			LumaHistogram centered;
+			f.sampleCentered(f, centered, buf.data(), w, h, bpl, 16, 0, h);
+			CHECK(centered.samples > 0);
+			CHECK(centered.mean() == expected);
+
+			// Rows 16 to 47 of the image, in a strip that starts at row 16
+			const int y_off = 16;
+			const SamplePoint pts[] { { 0, 16, 1 }, { w - 1, 20, 3 }, { 31, h - 1, 7 } };
+
+			LumaHistogram points;
+			f.samplePoints(f, points, &buf[size_t(y_off) * bpl], bpl, pts, 3, y_off);
+			CHECK(points.samples == 11);
+			CHECK(points.reads == 3);
+			CHECK(points.mean() == expected);
+		}
+	}
+}
@@ -0,0 +1,117 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <algorithm>
+#include <vector>
+#include "test.h"
+#include "ramp.h"
+#include "colortemp.h"
+#include "defs.h"
+
+namespace {
+
+const int    sizes[] { 1, 2, 3, 256, 1024, 1025, 2048, 4096 };
+const double gains[] { 0., 0.37, 0.5, 1., 1.3, 2. }; // Over 1: brt_extend
+
+// What fillRampChannel promises, in double precision
+double reference(int i, int size, double gain)
+{
+	if (size == 1)
+		return std::clamp(gain, 0., 1.) * UINT16_MAX;
+
+	return std::min(i * gain * UINT16_MAX / (size - 1), double(UINT16_MAX));
+}
+
+} // namespace
+
+TEST(ramp_is_monotonic)
+{
+	for (int sz : sizes) {
+		for (double g : gains) {
+			std::vector<uint16_t> v(sz);
+			fillRampChannel(v.data(), sz, g);
+
+			CHECK(std::is_sorted(v.begin(), v.end()));
+		}
+	}
+}
+
+TEST(ramp_endpoints)
+{
+	for (int sz : sizes) {
+		for (double g : gains) {
+			std::vector<uint16_t> v(sz);
+			fillRampChannel(v.data(), sz, g);
+
+			if (sz > 1)
+				CHECK(v.front() == 0);
+
+			// Full gain reaches white exactly, whatever the size
+			if (g >= 1)
+				CHECK(v.back() == UINT16_MAX);
+			else
+				CHECK_NEAR(v.back(), g * UINT16_MAX, 0.5);
+		}
+	}
+}
+
+/**
+ * Every entry is the rounded reference: at most half a step off.
+ */
+TEST(ramp_error_vs_reference)
+{
+	for (int sz : sizes) {
+		for (double g : gains) {
+			std::vector<uint16_t> v(sz);
+			fillRampChannel(v.data(), sz, g);
+
+			double max_err = 0;
+
+			for (int i = 0; i < sz; ++i)
+				max_err = std::max(max_err, std::abs(v[i] - reference(i, sz, g)));
+
+			CHECK(max_err <= 0.5 + 1e-9);
+		}
+	}
+}
+
+/**
+ * Each channel of the gamma ramp follows its own temperature multiplier.
+ */
+TEST(ramp_channels_vs_reference)
+{
+	const int sz = 1025;
+
+	for (int brt : { 0, 125, 250, brt_steps_max, 700 }) {
+		for (int temp : { 0, 100, 250, temp_steps_max }) {
+			std::vector<uint16_t> r(sz), g(sz), b(sz);
+			fillGammaRamp(r.data(), g.data(), b.data(), sz, brt, temp);
+
+			const uint16_t *ch[3] { r.data(), g.data(), b.data() };
+
+			for (int c = 0; c < 3; ++c) {
+				const double gain = double(brt) / brt_steps_max * tempMultiplier(temp, c);
+
+				for (int i = 0; i < sz; ++i)
+					CHECK_NEAR(ch[c][i], reference(i, sz, gain), 0.5 + 1e-9);
+			}
+		}
+	}
+}
+
+TEST(ramp_neutral_is_identity)
+{
+	for (int sz : sizes) {
+		if (sz < 2)
+			continue;
+
+		std::vector<uint16_t> r(sz), g(sz), b(sz);
+		fillGammaRamp(r.data(), g.data(), b.data(), sz, brt_steps_max, 0);
+
+		CHECK(r == g);
+		CHECK(g == b);
+		CHECK(r.back() == UINT16_MAX);
+	}
+}
@@ -0,0 +1,213 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <algorithm>
+#include <vector>
+#include "test.h"
+#include "sampler.h"
+#include "luma.h"
+#include "utils.h"
+#include "cfg.h"
+#include "defs.h"
+
+namespace {
+
+const int w = 256, h = 200, bpl = w * 4 + 16;
+
+// Each row is gray at its own level, so the histogram says which rows were read
+std::vector<uint8_t> rows()
+{
+	std::vector<uint8_t> buf(size_t(bpl) * h, 0xff);
+
+	for (int y = 0; y < h; ++y)
+		for (int x = 0; x < w; ++x)
+			for (int c = 0; c < 4; ++c)
+				buf[size_t(y) * bpl + x * 4 + c] = uint8_t(y);
+
+	return buf;
+}
+
+const PixelFormat xrgb = pixelFormat(32, 0xff0000, 0xff00, 0xff, false);
+
+void use(int samples, int region = REGION_FULL)
+{
+	cfg["brt_samples"] = samples;
+	cfg["brt_region"]  = region;
+}
+
+} // namespace
+
+/**
+ * The requested number of points, inside the image, row by row.
+ */
+TEST(sampler_points)
+{
+	for (bool centered : { false, true }) {
+		const std::vector<SamplePoint> pts = haltonPoints(w, h, 4096, centered);
+
+		CHECK(pts.size() == 4096);
+
+		for (const auto &p : pts) {
+			CHECK(p.x >= 0 && p.x < w);
+			CHECK(p.y >= 0 && p.y < h);
+			CHECK(p.weight >= 1);
+		}
+
+		CHECK(std::is_sorted(pts.begin(), pts.end(), [] (const SamplePoint &a, const SamplePoint &b) {
+			return a.y != b.y ? a.y < b.y : a.x < b.x;
+		}));
+	}
+
+	CHECK(haltonPoints(w, h, 0, false).empty());
+}
+
+/**
+ * Low discrepancy: every cell of a 4x4 grid gets its share of the points,
+ * and no column is sampled much more than another.
+ */
+TEST(sampler_points_even)
+{
+	const int n = 4096;
+	const std::vector<SamplePoint> pts = haltonPoints(1920, 1080, n, false);
+
+	int cells[16] {};
+	std::vector<int> cols(1920 / 8);
+
+	for (const auto &p : pts) {
+		++cells[p.y * 4 / 1080 * 4 + p.x * 4 / 1920];
+		++cols[p.x / 8];
+	}
+
+	for (int c : cells)
+		CHECK_NEAR(c, n / 16, n / 16 * 0.1);
+
+	CHECK(*std::max_element(cols.begin(), cols.end()) <= 2 * n / int(cols.size()));
+}
+
+/**
+ * The center weighted points count more in the middle than at the corners.
+ */
+TEST(sampler_points_centered)
+{
+	const std::vector<SamplePoint> pts = haltonPoints(w, h, 4096, true);
+
+	uint32_t center = 0, corner = 16;
+
+	for (const auto &p : pts) {
+		if (std::abs(p.x - w / 2) < w / 8 && std::abs(p.y - h / 2) < h / 8)
+			center = std::max(center, p.weight);
+		if ((p.x < w / 8 || p.x >= w - w / 8) && (p.y < h / 8 || p.y >= h - h / 8))
+			corner = std::min(corner, p.weight);
+	}
+
+	CHECK(center > 10);
+	CHECK(corner == 1);
+}
+
+/**
+ * The budget is read once per image, however many strips it's captured in:
+ * each strip finds its own points, and together they match the whole image.
+ */
+TEST(sampler_strips)
+{
+	const std::vector<uint8_t> buf = rows();
+
+	use(3000);
+
+	LumaHistogram whole;
+	samplePixels(xrgb, whole, buf.data(), w, h, bpl, 0, h);
+
+	CHECK(whole.reads == 3000);
+
+	for (int strip : { 1, 37, 64, 199 }) {
+		LumaHistogram merged;
+
+		for (int y = 0; y < h; y += strip) {
+			const int sh = std::min(strip, h - y);
+			samplePixels(xrgb, merged, &buf[size_t(y) * bpl], w, sh, bpl, y, h);
+		}
+
+		CHECK(merged.count == whole.count);
+		CHECK(merged.reads == whole.reads);
+	}
+
+	// A strip only holds its own rows
+	LumaHistogram part;
+	samplePixels(xrgb, part, &buf[size_t(50) * bpl], w, 20, bpl, 50, h);
+
+	CHECK(part.reads > 0);
+	CHECK(part.percentile(0) >= 50);
+	CHECK(part.percentile(100) < 70);
+}
+
+TEST(sampler_budget_capped)
+{
+	const std::vector<uint8_t> buf = rows();
+
+	use(1 << 30);
+
+	LumaHistogram hist;
+	samplePixels(xrgb, hist, buf.data(), w, h, bpl, 0, h);
+
+	CHECK(hist.reads <= uint64_t(w) * h);
+	CHECK(hist.reads > uint64_t(w) * h / 2);
+}
+
+/**
+ * With "brt_samples" at 0, every 1024th pixel in memory, padding included.
+ */
+TEST(sampler_stride_fallback)
+{
+	const std::vector<uint8_t> buf = rows();
+
+	use(0);
+
+	LumaHistogram hist;
+	samplePixels(xrgb, hist, buf.data(), w, h, bpl, 0, h);
+
+	const uint64_t bytes = uint64_t(bpl) * h;
+	CHECK(hist.reads == (bytes + 4 * 1024 - 1) / (4 * 1024));
+
+	use(0, REGION_CENTER_WEIGHTED);
+
+	LumaHistogram centered;
+	samplePixels(xrgb, centered, buf.data(), w, h, bpl, 0, h);
+	CHECK(centered.reads > 0);
+	CHECK(centered.samples > centered.reads);
+}
+
+/**
+ * The confidence interval shrinks with the budget, is zero on a uniform
+ * image, and is what brightnessMetric() reports for the capture.
+ */
+TEST(sampler_confidence)
+{
+	const std::vector<uint8_t> buf = rows();
+
+	double prev = 1e9;
+
+	for (int n : { 64, 256, 1024, 4096 }) {
+		use(n);
+
+		LumaHistogram hist;
+		samplePixels(xrgb, hist, buf.data(), w, h, bpl, 0, h);
+
+		const double ci = hist.confidence();
+		CHECK(ci > 0);
+		CHECK(ci < prev);
+		prev = ci;
+
+		// The true mean of the rows is within the interval
+		CHECK_NEAR(double(hist.sum) / hist.samples, (h - 1) / 2., ci);
+
+		brightnessMetric(hist);
+		CHECK(brightnessConfidence() == ci);
+	}
+
+	LumaHistogram flat;
+	flat.add(128, 500);
+	flat.add(128, 500);
+	CHECK(flat.confidence() == 0);
+}
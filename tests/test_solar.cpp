@@ -0,0 +1,183 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include "test.h"
+#include "solar.h"
+#include "cfg.h"
+
+namespace {
+
+const int high = 6500;
+const int low  = 3400;
+
+/* POSIX rules, so the tests don't depend on the tz database.
+ * Central Europe: DST from the last Sunday of March to the last one of October. */
+void setTimezone(const char *tz)
+{
+	setenv("TZ", tz, 1);
+	tzset();
+}
+
+time_t wallTime(int y, int mon, int d, int h, int min)
+{
+	tm t {};
+	t.tm_year  = y - 1900;
+	t.tm_mon   = mon - 1;
+	t.tm_mday  = d;
+	t.tm_hour  = h;
+	t.tm_min   = min;
+	t.tm_isdst = -1;
+	return mktime(&t);
+}
+
+void useSolar(TempCurve &c, double lat, double lon)
+{
+	cfg["temp_schedule"] = SCHEDULE_SOLAR;
+	cfg["temp_high"]     = high;
+	cfg["temp_low"]      = low;
+	cfg["temp_lat"]      = lat;
+	cfg["temp_lon"]      = lon;
+	c.invalidate();
+}
+
+// First wall clock minute after noon at which the temperature drops
+int eveningStart(TempCurve &c, int y, int mon, int d)
+{
+	for (int m = 12 * 60; m < 24 * 60; ++m) {
+		if (c.kelvinAt(wallTime(y, mon, d, m / 60, m % 60)) < high)
+			return m;
+	}
+
+	return -1;
+}
+
+} // namespace
+
+TEST(solar_noon_elevation)
+{
+	// 90 - latitude + declination, at the solstices and the equinox
+	const auto peak = [] (int y, int mon, int d, double lat, double lon) {
+		const time_t midnight_utc = wallTime(y, mon, d, 0, 0);
+		double max = -90;
+
+		for (int m = 0; m < 24 * 60; ++m)
+			max = std::max(max, solarElevation(midnight_utc + m * 60, lat, lon));
+
+		return max;
+	};
+
+	setTimezone("UTC0");
+
+	CHECK_NEAR(peak(2026, 6, 21, 41.9, 12.5), 90 - 41.9 + 23.44, 0.5);
+	CHECK_NEAR(peak(2026, 12, 21, 41.9, 12.5), 90 - 41.9 - 23.44, 0.5);
+	CHECK_NEAR(peak(2026, 3, 20, 0, 0), 90, 1);
+	CHECK_NEAR(peak(2026, 6, 21, -33.9, 151.2), 90 - 33.9 - 23.44, 0.5);
+}
+
+TEST(solar_polar_day)
+{
+	TempCurve c;
+
+	// Tromsø in June, McMurdo in December: the sun never sets
+	const struct { const char *tz; double lat, lon; int mon; } places[] {
+		{ "CET-1CEST,M3.5.0,M10.5.0/3", 69.65, 18.96,  6  },
+		{ "NZST-12NZDT,M9.5.0,M4.1.0/3", -77.85, 166.67, 12 },
+	};
+
+	for (const auto &p : places) {
+		setTimezone(p.tz);
+		useSolar(c, p.lat, p.lon);
+
+		for (int m = 0; m < 24 * 60; m += 7) {
+			const time_t t = wallTime(2026, p.mon, 21, m / 60, m % 60);
+			CHECK(c.kelvinAt(t) == high);
+			CHECK(!c.changing(t));
+		}
+	}
+}
+
+TEST(solar_polar_night)
+{
+	TempCurve c;
+
+	// Longyearbyen in December: the sun stays more than 6° below the horizon
+	setTimezone("CET-1CEST,M3.5.0,M10.5.0/3");
+	useSolar(c, 78.22, 15.65);
+
+	for (int m = 0; m < 24 * 60; m += 7) {
+		const time_t t = wallTime(2026, 12, 21, m / 60, m % 60);
+		CHECK(c.kelvinAt(t) == low);
+		CHECK(!c.changing(t));
+	}
+
+	// Tromsø in December: twilight at noon, but never daylight
+	useSolar(c, 69.65, 18.96);
+
+	int max = 0;
+	for (int m = 0; m < 24 * 60; m += 7)
+		max = std::max(max, c.kelvinAt(wallTime(2026, 12, 21, m / 60, m % 60)));
+
+	CHECK(max > low);
+	CHECK(max < high);
+}
+
+/**
+ * Sunset moves by an hour on the wall clock when DST starts and ends,
+ * and by only a minute or two in solar terms.
+ */
+TEST(solar_dst_transitions)
+{
+	TempCurve c;
+
+	setTimezone("CET-1CEST,M3.5.0,M10.5.0/3");
+	useSolar(c, 41.9, 12.5); // Rome
+
+	// DST starts on March 29th 2026
+	const int before_spring = eveningStart(c, 2026, 3, 28);
+	const int after_spring  = eveningStart(c, 2026, 3, 29);
+	CHECK(after_spring - before_spring >= 59);
+	CHECK(after_spring - before_spring <= 63);
+
+	// Sunset around 19:36 CEST, end of civil twilight around 20:04
+	CHECK(c.kelvinAt(wallTime(2026, 3, 29, 19, 20)) == high);
+	CHECK(c.kelvinAt(wallTime(2026, 3, 29, 20, 15)) == low);
+
+	// DST ends on October 25th 2026
+	const int before_fall = eveningStart(c, 2026, 10, 24);
+	const int after_fall  = eveningStart(c, 2026, 10, 25);
+	CHECK(before_fall - after_fall >= 59);
+	CHECK(before_fall - after_fall <= 63);
+
+	// Sunset around 17:12 CET, end of civil twilight around 17:40
+	CHECK(c.kelvinAt(wallTime(2026, 10, 25, 17, 0)) == high);
+	CHECK(c.kelvinAt(wallTime(2026, 10, 25, 17, 50)) == low);
+}
+
+/**
+ * Across the skipped and the repeated hour, the temperature follows
+ * real time without jumps.
+ */
+TEST(solar_dst_continuous)
+{
+	TempCurve c;
+
+	setTimezone("CET-1CEST,M3.5.0,M10.5.0/3");
+
+	// Oslo, where the twilight is long
+	useSolar(c, 59.91, 10.75);
+
+	for (const time_t start : { wallTime(2026, 3, 29, 0, 0), wallTime(2026, 10, 25, 0, 0) }) {
+		int prev = c.kelvinAt(start);
+
+		for (time_t t = start + 60; t < start + 23 * 3600; t += 60) {
+			const int k = c.kelvinAt(t);
+			CHECK(std::abs(k - prev) <= 150);
+			prev = k;
+		}
+	}
+}
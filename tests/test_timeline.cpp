@@ -0,0 +1,171 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include "test.h"
+#include "timeline.h"
+
+namespace {
+
+constexpr double h   = 60 * 60;
+constexpr double day = Timeline::day;
+
+/* Warm from 22:00 to 02:00, across midnight, cold again from 07:00 to 08:00.
+ * Given out of order on purpose. */
+Timeline night()
+{
+	Timeline tl;
+	tl.compile({
+		{ 8 * h,  6500, EASE_LINEAR },
+		{ 2 * h,  3400, EASE_LINEAR },
+		{ 22 * h, 6500, EASE_LINEAR },
+		{ 7 * h,  3400, EASE_LINEAR },
+	});
+	return tl;
+}
+
+} // namespace
+
+TEST(timeline_target)
+{
+	const Timeline tl = night();
+
+	CHECK(tl.target(12 * h) == 6500);
+	CHECK(tl.target(22 * h) == 6500);
+	CHECK(tl.target(4 * h) == 3400);
+	CHECK(tl.target(7 * h) == 3400);
+	CHECK_NEAR(tl.target(7.5 * h), 4950, 1e-9);
+	CHECK(tl.target(8 * h) == 6500);
+}
+
+/**
+ * The transition from 22:00 to 02:00 is a single segment,
+ * and any clock wraps onto the same day.
+ */
+TEST(timeline_midnight_wrap)
+{
+	const Timeline tl = night();
+
+	CHECK_NEAR(tl.target(23 * h), 5725, 1e-9);
+	CHECK_NEAR(tl.target(0), 4950, 1e-9);
+	CHECK_NEAR(tl.target(1 * h), 4175, 1e-9);
+	CHECK(tl.target(2 * h) == 3400);
+
+	CHECK_NEAR(tl.target(-1 * h), tl.target(23 * h), 1e-9);
+	CHECK_NEAR(tl.target(day + 1 * h), tl.target(1 * h), 1e-9);
+	CHECK_NEAR(tl.target(100 * day + 0.5 * h), tl.target(0.5 * h), 1e-6);
+}
+
+TEST(timeline_changing)
+{
+	const Timeline tl = night();
+
+	CHECK(tl.changing(23 * h));
+	CHECK(tl.changing(0));
+	CHECK(tl.changing(1.99 * h));
+	CHECK(tl.changing(7.5 * h));
+
+	// Between two keyframes with the same temperature
+	CHECK(!tl.changing(2 * h));
+	CHECK(!tl.changing(5 * h));
+	CHECK(!tl.changing(12 * h));
+	CHECK(!tl.changing(21.99 * h));
+}
+
+/**
+ * On the caller's clock: t itself during a transition,
+ * otherwise the start of the next one, which may be on the next day.
+ */
+TEST(timeline_next_change)
+{
+	const Timeline tl = night();
+
+	CHECK(tl.nextChange(3 * h) == 7 * h);
+	CHECK(tl.nextChange(12 * h) == 22 * h);
+	CHECK(tl.nextChange(23 * h) == 23 * h);
+	CHECK(tl.nextChange(5 * day + 12 * h) == 5 * day + 22 * h);
+
+	Timeline one;
+	one.compile({ { 12 * h, 5000, EASE_LINEAR } });
+	CHECK(one.nextChange(3 * h) == 3 * h + day);
+	CHECK(!one.changing(3 * h));
+	CHECK(one.target(3 * h) == 5000);
+
+	Timeline none;
+	none.compile({});
+	CHECK(none.empty());
+	CHECK(none.target(3 * h) == 0);
+	CHECK(none.nextChange(3 * h) == 3 * h + day);
+}
+
+/**
+ * The target leaves the range where the easing crosses its bound,
+ * or at the end of the transition if it never does.
+ */
+TEST(timeline_leave_time)
+{
+	const Timeline tl = night();
+
+	// 6500 to 3400 from 22:00 to 02:00: 5000 is crossed 1500/3100 of the way
+	const double t = tl.leaveTime(5000, 7000, 22.5 * h);
+	CHECK_NEAR(t, 22 * h + 4 * h * 1500 / 3100, 1e-6);
+	CHECK_NEAR(tl.target(t), 5000, 1e-6);
+
+	// Stays in range: the end of the transition, past midnight
+	CHECK(tl.leaveTime(3000, 7000, 22.5 * h) == day + 2 * h);
+	CHECK(tl.leaveTime(3000, 7000, 1 * h) == 2 * h);
+
+	// Brightening from 07:00 to 08:00, through the upper bound
+	const double up = tl.leaveTime(3000, 5000, 7.25 * h);
+	CHECK_NEAR(tl.target(up), 5000, 1e-6);
+	CHECK(up > 7.25 * h);
+
+	// Nothing changing: the start of the next transition
+	CHECK(tl.leaveTime(3000, 7000, 12 * h) == 22 * h);
+}
+
+/**
+ * A step transition holds the previous temperature, then jumps
+ * on its keyframe. It's never "changing", so nothing polls through it.
+ */
+TEST(timeline_step)
+{
+	Timeline tl;
+	tl.compile({
+		{ 6 * h,  6500, EASE_STEP },
+		{ 18 * h, 3400, EASE_STEP },
+	});
+
+	CHECK(tl.target(5.99 * h) == 3400);
+	CHECK(tl.target(6 * h) == 6500);
+	CHECK(tl.target(17.99 * h) == 6500);
+	CHECK(tl.target(18 * h) == 3400);
+	CHECK(tl.target(0) == 3400);
+
+	for (double t = 0; t < day; t += 0.25 * h)
+		CHECK(!tl.changing(t));
+
+	CHECK(tl.nextChange(12 * h) == 18 * h);
+	CHECK(tl.nextChange(20 * h) == day + 6 * h);
+	CHECK(tl.leaveTime(5000, 7000, 12 * h) == 18 * h);
+}
+
+/**
+ * Keyframes with the same time of day, after wrapping: the last one given wins.
+ */
+TEST(timeline_duplicate_times)
+{
+	Timeline tl;
+	tl.compile({
+		{ 10 * h,       5000, EASE_LINEAR },
+		{ 20 * h,       4000, EASE_LINEAR },
+		{ 10 * h,       6000, EASE_LINEAR },
+		{ day + 20 * h, 3000, EASE_LINEAR },
+	});
+
+	CHECK(tl.target(10 * h) == 6000);
+	CHECK(tl.target(20 * h) == 3000);
+	CHECK_NEAR(tl.target(15 * h), 4500, 1e-9);
+	CHECK_NEAR(tl.target(3 * h), 4500, 1e-9);
+}
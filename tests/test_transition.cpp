@@ -0,0 +1,124 @@
+/**
+ * Copyright (C) Francesco Fusco. All rights reserved.
+ * License: https://github.com/Fushko/gammy#license
+ */
+
+#include <cmath>
+#include <utility>
+#include "test.h"
+#include "transition.h"
+
+namespace {
+
+/* Follows the spring the way adjustBrightness() does: sleeping until
+ * the next step change. Each wake-up must move by exactly one step,
+ * and the wake-ups must move forward in time. Returns the last step. */
+int walk(const Spring &s, double &t, int &updates)
+{
+	int prev = s.stepAt(t);
+
+	while (!s.done(t)) {
+		const double next = s.nextStepTime(t);
+
+		if (std::isinf(next))
+			break;
+
+		CHECK(next > t);
+		t = next;
+
+		const int step = s.stepAt(t);
+		CHECK(std::abs(step - prev) == 1);
+		prev = step;
+		++updates;
+	}
+
+	return prev;
+}
+
+} // namespace
+
+TEST(spring_every_step_once)
+{
+	const std::pair<int, int> moves[] { { 0, 500 }, { 500, 123 }, { 250, 251 }, { 10, 3 } };
+
+	for (const auto &[from, to] : moves) {
+		Spring s(from, 0.5);
+		s.retarget(to, 0, 0.5);
+
+		double t = 0;
+		int    updates = 0;
+
+		CHECK(walk(s, t, updates) == to);
+		CHECK(updates == std::abs(to - from));
+		CHECK(s.done(t));
+		CHECK(std::isinf(s.nextStepTime(t)));
+	}
+}
+
+/**
+ * A new target keeps the position and the velocity: no jump in either.
+ */
+TEST(spring_retarget_is_continuous)
+{
+	Spring s(0, 1);
+	s.retarget(400, 0, 1);
+
+	const std::pair<double, int> retargets[] { { 0.1, 300 }, { 0.25, 50 }, { 0.4, 300 }, { 0.45, 300 } };
+
+	for (const auto &[t, target] : retargets) {
+		const double x = s.position(t);
+		const double v = s.velocity(t);
+
+		s.retarget(target, t, 1);
+
+		CHECK_NEAR(s.position(t), x, 1e-9);
+		CHECK_NEAR(s.velocity(t), v, 1e-6);
+		CHECK(s.target() == target);
+	}
+
+	// Turning around after the retargets still emits single steps
+	double t       = 0.45;
+	int    updates = 0;
+
+	CHECK(walk(s, t, updates) == 300);
+	CHECK(updates > 0);
+}
+
+/**
+ * A scene that keeps changing: a new target every 150 ms, before
+ * the spring settles. Continuous at every retarget, and it still
+ * lands on the last target one step at a time.
+ */
+TEST(spring_rapid_targets)
+{
+	Spring s(250, 0.5);
+	int    last = 250;
+
+	for (int i = 0; i < 40; ++i) {
+		const double t = i * 0.15;
+		const double x = s.position(t);
+		const double v = s.velocity(t);
+
+		last = 250 + int(200 * std::sin(i * 0.9));
+		s.retarget(last, t, 0.5);
+
+		CHECK_NEAR(s.position(t), x, 1e-9);
+		CHECK_NEAR(s.velocity(t), v, 1e-6);
+	}
+
+	double t       = 39 * 0.15;
+	int    updates = 0;
+
+	CHECK(walk(s, t, updates) == last);
+}
+
+TEST(spring_reset)
+{
+	Spring s(0, 0.5);
+	s.retarget(100, 0, 0.5);
+	s.reset(42, 0.2);
+
+	CHECK(s.stepAt(0.2) == 42);
+	CHECK(s.velocity(0.2) == 0);
+	CHECK(s.done(0.2));
+}
@@ -0,0 +1,42 @@
+#-------------------------------------------------
+#
+# Unit tests for the Qt-free parts of Gammy.
+# cd tests && qmake && make && ./gammy-tests
+#
+#-------------------------------------------------
+
+TARGET   = gammy-tests
+TEMPLATE = app
+CONFIG  += console c++1z
+CONFIG  -= qt app_bundle
+
+INCLUDEPATH += $$PWD/../include $$PWD/../src
+OBJECTS_DIR  = build/obj
+
+HEADERS += test.h
+
+SOURCES += main.cpp \
+    test_pixfmt.cpp \
+    test_luma.cpp \
+    test_sampler.cpp \
+    test_ramp.cpp \
+    test_colortemp.cpp \
+    test_calibration.cpp \
+    test_solar.cpp \
+    test_transition.cpp \
+    test_easing.cpp \
+    test_timeline.cpp
+
+# Code under test
+SOURCES += ../src/pixfmt.cpp \
+    ../src/luma.cpp \
+    ../src/ramp.cpp \
+    ../src/solar.cpp \
+    ../src/timeline.cpp \
+    ../src/easing.cpp \
+    ../src/transition.cpp
+
+# utils.cpp (normalize, remap) pulls in the config and the sampler
+SOURCES += ../src/utils.cpp \
+    ../src/cfg.cpp \
+    ../src/sampler.cpp